@@ -0,0 +1,142 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "scheduler.h"
+
+/* Weighted fair sharing, after the Linux CFS.
+ *
+ * Every process accumulates a virtual runtime: the time it has run, scaled by
+ * CFS_DEFAULT_WEIGHT / weight, so a process of twice the weight gets twice the time for the
+ * same vruntime. It is kept in units of 2^-CFS_VRUNTIME_SHIFT time units, so that heavy weights
+ * keep their precision, and a time slice always moves it on by at least one, so that even the
+ * heaviest process is preempted. The waiting processes of a CPU are kept in a red-black tree ordered by
+ * (vruntime, pid), see rbtree.c. The running process is out of the tree, as in Linux.
+ *
+ * Time is counted in time slices of cfs_granularity units, driven by the RR time slice timer,
+ * and a time slice is charged to the process running when it ends. Only then may the leftmost
+ * process preempt the running one, so no process is preempted before it has run for the
+ * minimum granularity. A process that arrives starts at the least vruntime of its CPU, so it
+ * shares the CPU from then on instead of catching up on the time it wasn't there. A process
+ * stolen by another CPU leaves with its vruntime made relative to the least vruntime of its
+ * CPU, and is placed as far ahead of the least vruntime of the CPU that stole it, as in Linux.
+ */
+
+#define CFS_VRUNTIME_SHIFT 16
+
+int cfs_granularity = 100;
+
+typedef struct RunQueue {
+    RbTree waiting;
+    ProcessInfo *running;
+    bool resched; // A time slice has ended since the last context switch
+    long min_vruntime; // Never goes down
+    int process_count; // In the tree or running
+} RunQueue;
+
+static RunQueue *run_queues; // One per CPU
+
+static void update_min_vruntime(RunQueue *rq) {
+    ProcessInfo *first = rbtree_first(&rq->waiting);
+    long least = rq->min_vruntime;
+    if (rq->running != NULL) {
+        least = rq->running->vruntime;
+    }
+    if (first != NULL && (rq->running == NULL || first->vruntime < least)) {
+        least = first->vruntime;
+    }
+    if (least > rq->min_vruntime) {
+        rq->min_vruntime = least;
+    }
+}
+
+static void set_strategy_CFS(int unused) {
+    (void) unused;
+    run_queues = (RunQueue *) calloc(num_cpus, sizeof(RunQueue));
+    for (int cpu = 0; cpu < num_cpus; cpu++) {
+        rbtree_init(&run_queues[cpu].waiting);
+    }
+}
+
+static void add_process_CFS(ProcessInfo *p) {
+    RunQueue *rq = &run_queues[current_cpu];
+    // Relative to min_vruntime: 0 for an arrival, its lag on its former CPU for a stolen process
+    p->vruntime += rq->min_vruntime;
+    rbtree_insert(&rq->waiting, p);
+    rq->process_count++;
+}
+
+static void remove_current_process_CFS(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    assert(rq->running != NULL);
+    rq->running = NULL;
+    rq->process_count--;
+    update_min_vruntime(rq);
+}
+
+static void timeslice_over_CFS(long now) {
+    (void) now;
+    RunQueue *rq = &run_queues[current_cpu];
+    if (rq->running != NULL) {
+        long delta = ((long) cfs_granularity << CFS_VRUNTIME_SHIFT) * CFS_DEFAULT_WEIGHT / rq->running->weight;
+        rq->running->vruntime += delta > 0 ? delta : 1;
+        rq->resched = true;
+        update_min_vruntime(rq);
+    }
+}
+
+static void context_switch_CFS(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    ProcessInfo *first = rbtree_first(&rq->waiting);
+    ProcessInfo *next = rq->running;
+    if (rq->running == NULL || (rq->resched && first != NULL && rbtree_before(first, rq->running))) {
+        next = first;
+    }
+    rq->resched = false;
+    if (next == rq->running) {
+        return;
+    }
+    if (rq->running != NULL) {
+        suspend_process(rq->running->pid);
+        rbtree_insert(&rq->waiting, rq->running);
+    }
+    if (next != NULL) {
+        rbtree_erase(&rq->waiting, next);
+        resume_process(next->pid);
+    }
+    rq->running = next;
+}
+
+static bool scheduler_empty_CFS(void) {
+    return run_queues[current_cpu].process_count == 0;
+}
+
+static int queue_length_CFS(void) {
+    return run_queues[current_cpu].process_count;
+}
+
+static ProcessInfo *steal_process_CFS(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    ProcessInfo *stolen = rbtree_first(&rq->waiting);
+    if (stolen != NULL) {
+        rbtree_erase(&rq->waiting, stolen);
+        rq->process_count--;
+        stolen->vruntime -= rq->min_vruntime;
+    }
+    return stolen;
+}
+
+static int timeslice_length_CFS(void) {
+    return cfs_granularity;
+}
+
+const SchedulerOps CFS_ops = {
+    .name = "CFS",
+    .set_strategy = set_strategy_CFS,
+    .add_process = add_process_CFS,
+    .remove_current_process = remove_current_process_CFS,
+    .timeslice_over = timeslice_over_CFS,
+    .timeslice_length = timeslice_length_CFS,
+    .context_switch = context_switch_CFS,
+    .scheduler_empty = scheduler_empty_CFS,
+    .queue_length = queue_length_CFS,
+    .steal_process = steal_process_CFS,
+};
@@ -0,0 +1,246 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "scheduler.h"
+
+/* Earliest deadline first.
+ *
+ * The run queue of preemptive.c, as in PSJF.c, ordered by edf_deadline instead of the
+ * remaining time. Processes without a deadline run when no process with one is waiting.
+ *
+ * Admission control: a process with a deadline is admitted if, running the processes of its CPU
+ * in deadline order from now on, it and every other admitted one still finish in time.
+ * Otherwise it is OVER_CAPACITY and still scheduled by its deadline, or with
+ * --edf-admission reject, REJECTED and scheduled as if it had none.
+ *
+ * The processes scheduled by a deadline are also kept in a treap in deadline order. Each node
+ * knows the work in its subtree and the least slack in it, the slack of a process being its
+ * deadline minus the time it would finish at. While the first process runs, the clock and its
+ * remaining time move together, so no slack changes; an arrival lowers the slack of the
+ * processes after it by its remaining time. Both the check and the updates are O(log n).
+ */
+
+bool edf_reject = false;
+
+typedef struct EdfNode {
+    ProcessInfo *process;
+    struct EdfNode *left, *right;
+    unsigned priority; // Not above the priority of its parent
+    long work; // Remaining time of the process at the last event
+    long total_work; // Of the subtree
+    long min_slack; // Of the subtree, as if it started at time 0; LONG_MAX if no process in it counts
+} EdfNode;
+
+typedef struct RunQueue {
+    PreemptiveQueue queue;
+    EdfNode *deadlines; // The treap
+} RunQueue;
+
+static RunQueue *run_queues; // One per CPU
+static unsigned treap_seed = 1;
+
+static bool edf_before(const ProcessInfo *lhs, const ProcessInfo *rhs) {
+    if (lhs->edf_deadline == rhs->edf_deadline) {
+        return lhs->pid < rhs->pid;
+    }
+    return lhs->edf_deadline < rhs->edf_deadline;
+}
+
+static long subtree_work(EdfNode *t) {
+    return t != NULL ? t->total_work : 0;
+}
+
+static long min_long(long lhs, long rhs) {
+    return lhs < rhs ? lhs : rhs;
+}
+
+static void pull(EdfNode *t) {
+    long work_before = subtree_work(t->left) + t->work; // Up to and including t
+    t->total_work = work_before + subtree_work(t->right);
+    t->min_slack = t->left != NULL ? t->left->min_slack : LONG_MAX;
+    // A process admitted over capacity delays the others, but may be late itself.
+    if (t->process->admission != OVER_CAPACITY) {
+        t->min_slack = min_long(t->min_slack, t->process->edf_deadline - work_before);
+    }
+    if (t->right != NULL && t->right->min_slack != LONG_MAX) {
+        t->min_slack = min_long(t->min_slack, t->right->min_slack - work_before);
+    }
+}
+
+/* Splits t into the nodes before p and the others. */
+static void treap_split(EdfNode *t, ProcessInfo *p, EdfNode **before, EdfNode **after) {
+    if (t == NULL) {
+        *before = *after = NULL;
+    } else if (edf_before(t->process, p)) {
+        treap_split(t->right, p, &t->right, after);
+        pull(t);
+        *before = t;
+    } else {
+        treap_split(t->left, p, before, &t->left);
+        pull(t);
+        *after = t;
+    }
+}
+
+static EdfNode *treap_merge(EdfNode *before, EdfNode *after) {
+    if (before == NULL || after == NULL) {
+        return before != NULL ? before : after;
+    }
+    if (before->priority > after->priority) {
+        before->right = treap_merge(before->right, after);
+        pull(before);
+        return before;
+    }
+    after->left = treap_merge(before, after->left);
+    pull(after);
+    return after;
+}
+
+static void treap_insert(RunQueue *rq, ProcessInfo *p) {
+    EdfNode *node = (EdfNode *) malloc(sizeof(EdfNode));
+    treap_seed = treap_seed * 1103515245 + 12345;
+    *node = (EdfNode) {p, NULL, NULL, treap_seed, p->remaining_time, 0, 0};
+    pull(node);
+    p->edf_node = node;
+    EdfNode *before, *after;
+    treap_split(rq->deadlines, p, &before, &after);
+    rq->deadlines = treap_merge(treap_merge(before, node), after);
+}
+
+static EdfNode *treap_erase(EdfNode *t, ProcessInfo *p) {
+    if (t->process == p) {
+        EdfNode *rest = treap_merge(t->left, t->right);
+        free(t);
+        p->edf_node = NULL;
+        return rest;
+    }
+    if (edf_before(p, t->process)) {
+        t->left = treap_erase(t->left, p);
+    } else {
+        t->right = treap_erase(t->right, p);
+    }
+    pull(t);
+    return t;
+}
+
+static void treap_set_work(EdfNode *t, ProcessInfo *p) {
+    if (t->process == p) {
+        t->work = p->remaining_time;
+    } else if (edf_before(p, t->process)) {
+        treap_set_work(t->left, p);
+    } else {
+        treap_set_work(t->right, p);
+    }
+    pull(t);
+}
+
+static bool all_in_time(RunQueue *rq) {
+    return rq->deadlines == NULL || rq->deadlines->min_slack == LONG_MAX
+            || rq->deadlines->min_slack >= rq->queue.current_time;
+}
+
+static void admit(RunQueue *rq, ProcessInfo *p) {
+    p->edf_deadline = p->deadline;
+    p->admission = ADMITTED;
+    if (p->deadline == NO_DEADLINE) {
+        return;
+    }
+    treap_insert(rq, p);
+    if (all_in_time(rq)) {
+        return;
+    }
+    rq->deadlines = treap_erase(rq->deadlines, p);
+    if (edf_reject) {
+        p->admission = REJECTED;
+        p->edf_deadline = NO_DEADLINE;
+    } else {
+        p->admission = OVER_CAPACITY;
+        treap_insert(rq, p);
+    }
+}
+
+static void add_process_EDF(ProcessInfo *new_process) {
+    RunQueue *rq = &run_queues[current_cpu];
+    ProcessInfo *charged = preemptive_arrive(&rq->queue, new_process);
+    if (charged != NULL && charged->edf_node != NULL) {
+        treap_set_work(rq->deadlines, charged);
+    }
+    if (new_process->admission == NOT_ADMITTED) {
+        admit(rq, new_process);
+    } else if (new_process->edf_deadline != NO_DEADLINE) {
+        treap_insert(rq, new_process); // Stolen; its first CPU has admitted it.
+    }
+    heap_insert(&rq->queue.pq, new_process);
+}
+
+static void set_strategy_EDF(int num_process) {
+    run_queues = (RunQueue *) calloc(num_cpus, sizeof(RunQueue));
+    for (int cpu = 0; cpu < num_cpus; cpu++) {
+        preemptive_init(&run_queues[cpu].queue, num_process, DEADLINE_KEY);
+    }
+}
+
+/* Takes p out of the deadline order, if it is in it. */
+static ProcessInfo *forget_deadline(RunQueue *rq, ProcessInfo *p) {
+    if (p != NULL && p->edf_node != NULL) {
+        rq->deadlines = treap_erase(rq->deadlines, p);
+    }
+    return p;
+}
+
+static void remove_current_process_EDF(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    forget_deadline(rq, preemptive_terminate(&rq->queue));
+}
+
+static void context_switch_EDF(void) {
+    preemptive_context_switch(&run_queues[current_cpu].queue);
+}
+
+static bool scheduler_empty_EDF(void) {
+    return preemptive_empty(&run_queues[current_cpu].queue);
+}
+
+static int queue_length_EDF(void) {
+    return heap_size(&run_queues[current_cpu].queue.pq);
+}
+
+static ProcessInfo *steal_process_EDF(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    return forget_deadline(rq, preemptive_steal(&rq->queue));
+}
+
+static int with_deadline = 0, missed = 0, over_capacity = 0, rejected = 0; // Reported so far
+static long max_lateness = 0;
+
+void edf_report_process(ProcessInfo *p) {
+    if (p->deadline == NO_DEADLINE) {
+        return;
+    }
+    long lateness = p->finish_time - p->deadline;
+    with_deadline++;
+    missed += lateness > 0;
+    over_capacity += p->admission == OVER_CAPACITY;
+    rejected += p->admission == REJECTED;
+    if (with_deadline == 1 || lateness > max_lateness) {
+        max_lateness = lateness;
+    }
+    fprintf(stderr, "%s: deadline %d, finished %ld, lateness %ld%s%s\n", p->name, p->deadline,
+            p->finish_time, lateness, lateness > 0 ? ", missed" : "",
+            p->admission == OVER_CAPACITY ? ", admitted over capacity" : p->admission == REJECTED ? ", rejected" : "");
+}
+
+void edf_print_report(void) {
+    fprintf(stderr, "EDF: %d of %d deadlines missed, max lateness %ld; %d admitted over capacity, %d rejected\n",
+            missed, with_deadline, max_lateness, over_capacity, rejected);
+}
+
+const SchedulerOps EDF_ops = {
+    .name = "EDF",
+    .set_strategy = set_strategy_EDF,
+    .add_process = add_process_EDF,
+    .remove_current_process = remove_current_process_EDF,
+    .context_switch = context_switch_EDF,
+    .scheduler_empty = scheduler_empty_EDF,
+    .queue_length = queue_length_EDF,
+    .steal_process = steal_process_EDF,
+};
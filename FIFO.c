@@ -1,20 +1,88 @@
+#include <stdlib.h>
 #include "scheduler.h"
 
-static int count_process = 0;
+#define FIFO_INITIAL_CAPACITY 16
 
-void set_strategy_FIFO(int unused) {} // no data structures needed
+/* The kernel runs the resumed processes of a CPU in the order they were resumed,
+ * so the queue only mirrors that order for work stealing. The head is the process running. */
+typedef struct RunQueue {
+    ProcessInfo **ring;
+    int head;
+    int count;
+    int capacity;
+} RunQueue;
 
-void add_process_FIFO(ProcessInfo *p) {
+static RunQueue *run_queues; // One per CPU
+
+static ProcessInfo **ring_slot(RunQueue *rq, int i) {
+    return &rq->ring[(rq->head + i) % rq->capacity];
+}
+
+static void ring_grow(RunQueue *rq) {
+    ProcessInfo **ring = (ProcessInfo **) malloc(sizeof(ProcessInfo *) * rq->capacity * 2);
+    for (int i = 0; i < rq->count; i++) {
+        ring[i] = *ring_slot(rq, i);
+    }
+    free(rq->ring);
+    rq->ring = ring;
+    rq->head = 0;
+    rq->capacity *= 2;
+}
+
+static void set_strategy_FIFO(int unused) {
+    run_queues = (RunQueue *) calloc(num_cpus, sizeof(RunQueue));
+    for (int cpu = 0; cpu < num_cpus; cpu++) {
+        run_queues[cpu].capacity = FIFO_INITIAL_CAPACITY;
+        run_queues[cpu].ring = (ProcessInfo **) malloc(sizeof(ProcessInfo *) * FIFO_INITIAL_CAPACITY);
+    }
+}
+
+static void add_process_FIFO(ProcessInfo *p) {
+    RunQueue *rq = &run_queues[current_cpu];
+    if (rq->count == rq->capacity) {
+        ring_grow(rq);
+    }
+    *ring_slot(rq, rq->count) = p;
+    rq->count++;
     resume_process(p->pid);
-    count_process++;
 }
 
-void remove_current_process_FIFO(void) {
-    count_process--;
+static void remove_current_process_FIFO(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    rq->head = (rq->head + 1) % rq->capacity;
+    rq->count--;
+}
+
+static void context_switch_FIFO(void) {} // unused
+
+static bool scheduler_empty_FIFO(void) {
+    return run_queues[current_cpu].count == 0;
 }
 
-void context_switch_FIFO(void) {} // unused
+static int queue_length_FIFO(void) {
+    return run_queues[current_cpu].count;
+}
 
-bool scheduler_empty_FIFO(void) {
-    return count_process == 0;
+static ProcessInfo *steal_process_FIFO(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    if (rq->count < 2) {
+        return NULL;
+    }
+    // The process after the head is next; the head moves over it.
+    ProcessInfo *stolen = *ring_slot(rq, 1);
+    *ring_slot(rq, 1) = *ring_slot(rq, 0);
+    rq->head = (rq->head + 1) % rq->capacity;
+    rq->count--;
+    return stolen;
 }
+
+const SchedulerOps FIFO_ops = {
+    .name = "FIFO",
+    .set_strategy = set_strategy_FIFO,
+    .add_process = add_process_FIFO,
+    .remove_current_process = remove_current_process_FIFO,
+    .context_switch = context_switch_FIFO,
+    .scheduler_empty = scheduler_empty_FIFO,
+    .queue_length = queue_length_FIFO,
+    .steal_process = steal_process_FIFO,
+};
@@ -0,0 +1,231 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include "scheduler.h"
+
+/* Highest response ratio next.
+ *
+ * Like SJF, a process runs until it terminates, but the next one is the waiting process with
+ * the highest response ratio (waited + time needed) / time needed, so a long process that
+ * keeps waiting eventually goes before the short ones that arrive after it.
+ *
+ * The ratios change with time, and not in the same way, so the order can't be kept in a heap
+ * without re-keying every process. Instead, the waiting processes are the leaves of a kinetic
+ * tournament tree: every node holds the winner of its two children at the current time and
+ * the first time at which the loser will overtake it, as the ratios are linear in time. Moving
+ * the time forward only replays the matches whose time has come, found through the earliest
+ * such time in each subtree, and a process arriving or leaving replays the matches on its path.
+ * Each process holds a leaf, which is reused by the next one that arrives, and the tree doubles
+ * when every leaf is taken, as in LOTTERY.c.
+ */
+
+#define NEVER LONG_MAX
+#define HRRN_INITIAL_LEAVES 64
+
+typedef struct RunQueue {
+    int capacity; // Leaves
+    ProcessInfo **leaves; // The leaves are the nodes from capacity to 2 * capacity - 1; NULL if free
+    int *winner; // winner[node] is a leaf, or 0 if there is no process below the node
+    long *next_match; // The earliest time at which a match below node, or at node, changes
+    int *free_leaves; // A stack
+    int free_count;
+    ProcessInfo *active_process;
+    long active_until; // When active_process terminates
+    long current_time;
+    int process_count; // Waiting or running
+} RunQueue;
+
+static RunQueue *run_queues; // One per CPU
+
+/* Whether lhs goes before rhs at time now */
+static bool hrrn_before(const ProcessInfo *lhs, const ProcessInfo *rhs, long now) {
+    // (now - lhs->arrival_time) / lhs->time_needed against the same for rhs, without division
+    __int128 lhs_ratio = (__int128) (now - lhs->arrival_time) * rhs->time_needed;
+    __int128 rhs_ratio = (__int128) (now - rhs->arrival_time) * lhs->time_needed;
+    if (lhs_ratio == rhs_ratio) {
+        return lhs->pid < rhs->pid;
+    }
+    return lhs_ratio > rhs_ratio;
+}
+
+static long floor_div(long num, long den) {
+    return num / den - (num % den != 0 && (num < 0) != (den < 0));
+}
+
+/* The first time after now at which loser goes before winner, or NEVER */
+static long overtake_time(const ProcessInfo *winner, const ProcessInfo *loser, long now) {
+    // The ratio of the process needing less time grows faster, so only that one can overtake.
+    long slower = winner->time_needed - loser->time_needed;
+    if (slower <= 0) {
+        return NEVER;
+    }
+    // loser goes before winner once now * slower > num, or at equality if the pid favours it.
+    long num = (long) loser->arrival_time * winner->time_needed - (long) winner->arrival_time * loser->time_needed;
+    long time = floor_div(num, slower) + 1;
+    if (loser->pid < winner->pid && num % slower == 0) {
+        time--;
+    }
+    return time > now ? time : now + 1;
+}
+
+static long min_time(long lhs, long rhs) {
+    return lhs < rhs ? lhs : rhs;
+}
+
+/* Replays the match at an internal node, whose children are up to date. */
+static void replay(RunQueue *rq, int node) {
+    int left = rq->winner[2 * node], right = rq->winner[2 * node + 1];
+    long next = min_time(rq->next_match[2 * node], rq->next_match[2 * node + 1]);
+    if (left == 0 || right == 0) {
+        rq->winner[node] = left != 0 ? left : right;
+    } else {
+        ProcessInfo *lhs = rq->leaves[left], *rhs = rq->leaves[right];
+        bool left_wins = hrrn_before(lhs, rhs, rq->current_time);
+        rq->winner[node] = left_wins ? left : right;
+        next = min_time(next, left_wins ? overtake_time(lhs, rhs, rq->current_time)
+                                        : overtake_time(rhs, lhs, rq->current_time));
+    }
+    rq->next_match[node] = next;
+}
+
+/* Replays every match whose time has come below node. */
+static void advance(RunQueue *rq, int node) {
+    if (rq->next_match[node] > rq->current_time) {
+        return;
+    }
+    advance(rq, 2 * node);
+    advance(rq, 2 * node + 1);
+    replay(rq, node);
+}
+
+/* Sets a leaf and replays the matches on its path to the root. */
+static void set_leaf(RunQueue *rq, int leaf, ProcessInfo *p) {
+    advance(rq, 1);
+    rq->leaves[leaf] = p;
+    rq->winner[leaf] = p != NULL ? leaf : 0;
+    for (int node = leaf / 2; node >= 1; node /= 2) {
+        replay(rq, node);
+    }
+}
+
+/* The waiting process with the highest response ratio, or NULL */
+static ProcessInfo *top(RunQueue *rq) {
+    if (rq->capacity == 0) {
+        return NULL; // No process has come to this CPU yet.
+    }
+    advance(rq, 1);
+    return rq->winner[1] != 0 ? rq->leaves[rq->winner[1]] : NULL;
+}
+
+static void take(RunQueue *rq, ProcessInfo *p) {
+    set_leaf(rq, p->queue_slot, NULL);
+    rq->free_leaves[rq->free_count++] = p->queue_slot;
+    p->queue_slot = -1;
+}
+
+/* Doubles the leaves once they are all taken, and plays every match again at the current time.
+ * The order of the processes doesn't depend on their leaves, only on their ratios and pids. */
+static void grow(RunQueue *rq) {
+    int old_capacity = rq->capacity;
+    ProcessInfo **old_leaves = rq->leaves;
+    rq->capacity = old_capacity > 0 ? old_capacity * 2 : HRRN_INITIAL_LEAVES;
+    free(rq->winner);
+    free(rq->next_match);
+    rq->leaves = (ProcessInfo **) calloc(2 * rq->capacity, sizeof(ProcessInfo *));
+    rq->winner = (int *) calloc(2 * rq->capacity, sizeof(int));
+    rq->next_match = (long *) malloc(sizeof(long) * 2 * rq->capacity);
+    for (int node = 0; node < 2 * rq->capacity; node++) {
+        rq->next_match[node] = NEVER;
+    }
+    for (int i = 0; i < old_capacity; i++) {
+        ProcessInfo *p = old_leaves[old_capacity + i];
+        if (p != NULL) {
+            p->queue_slot = rq->capacity + i;
+            rq->leaves[p->queue_slot] = p;
+            rq->winner[p->queue_slot] = p->queue_slot;
+        }
+    }
+    free(old_leaves);
+    for (int node = rq->capacity - 1; node >= 1; node--) {
+        replay(rq, node);
+    }
+    rq->free_leaves = (int *) realloc(rq->free_leaves, sizeof(int) * rq->capacity);
+    // The leftmost leaves are handed out first.
+    for (int leaf = 2 * rq->capacity - 1; leaf >= rq->capacity + old_capacity; leaf--) {
+        rq->free_leaves[rq->free_count++] = leaf;
+    }
+}
+
+static void set_strategy_HRRN(int num_process) {
+    (void) num_process; // The slots are doubled when they are all taken instead.
+    run_queues = (RunQueue *) calloc(num_cpus, sizeof(RunQueue));
+}
+
+static void add_process_HRRN(ProcessInfo *p) {
+    RunQueue *rq = &run_queues[current_cpu];
+    // A process stolen from another CPU arrived earlier than the time this CPU has reached.
+    if (p->arrival_time > rq->current_time) {
+        rq->current_time = p->arrival_time;
+    }
+    if (rq->free_count == 0) {
+        grow(rq);
+    }
+    p->queue_slot = rq->free_leaves[--rq->free_count];
+    set_leaf(rq, p->queue_slot, p);
+    rq->process_count++;
+}
+
+static void remove_current_process_HRRN(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    assert(rq->active_process != NULL);
+    // In a real run, an arrival handled after a late exit may already have moved the time on.
+    if (rq->active_until > rq->current_time) {
+        rq->current_time = rq->active_until;
+    }
+    rq->active_process = NULL;
+    rq->process_count--;
+}
+
+static void context_switch_HRRN(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    if (rq->active_process != NULL) {
+        return; // No preemption
+    }
+    ProcessInfo *next = top(rq);
+    if (next == NULL) {
+        return; // Idle until the next process arrives
+    }
+    take(rq, next);
+    rq->active_process = next;
+    rq->active_until = rq->current_time + next->time_needed;
+    resume_process(next->pid);
+}
+
+static bool scheduler_empty_HRRN(void) {
+    return run_queues[current_cpu].process_count == 0;
+}
+
+static int queue_length_HRRN(void) {
+    return run_queues[current_cpu].process_count;
+}
+
+static ProcessInfo *steal_process_HRRN(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    ProcessInfo *stolen = top(rq);
+    if (stolen != NULL) {
+        take(rq, stolen);
+        rq->process_count--;
+    }
+    return stolen;
+}
+
+const SchedulerOps HRRN_ops = {
+    .name = "HRRN",
+    .set_strategy = set_strategy_HRRN,
+    .add_process = add_process_HRRN,
+    .remove_current_process = remove_current_process_HRRN,
+    .context_switch = context_switch_HRRN,
+    .scheduler_empty = scheduler_empty_HRRN,
+    .queue_length = queue_length_HRRN,
+    .steal_process = steal_process_HRRN,
+};
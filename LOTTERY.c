@@ -0,0 +1,206 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "scheduler.h"
+
+/* Lottery scheduling.
+ *
+ * Each time slice, a ticket is drawn among the tickets of the processes of a CPU, the running
+ * one included, and its holder runs until the time slice ends. A process gets its share of the
+ * time slices on average, as opposed to within one time slice as with STRIDE.c.
+ *
+ * Every process of a CPU holds a slot, and a Fenwick tree over the slots sums their tickets,
+ * so drawing, arriving and terminating are O(log n). A slot that is freed is reused by the next
+ * process that arrives, and the slots double when they are all taken, so there are never more
+ * than twice as many as processes on the CPU at once. The draws come from a generator seeded
+ * by --seed, so a run can be repeated exactly.
+ */
+
+#define LOTTERY_INITIAL_SLOTS 64
+
+unsigned long lottery_seed = 1;
+
+typedef struct RunQueue {
+    long *fenwick; // fenwick[i] sums the tickets of the slots i - (i & -i) + 1 .. i
+    ProcessInfo **slots; // slots[i] holds a process, or NULL; from 1
+    int *free_slots; // A stack
+    int free_count;
+    long total_tickets;
+    ProcessInfo *running;
+    bool resched; // A time slice has ended since the last context switch
+    int process_count; // Holding a slot, running or not
+    int capacity; // Slots
+} RunQueue;
+
+static RunQueue *run_queues; // One per CPU
+static uint64_t random_state;
+
+/* splitmix64 */
+static uint64_t next_random(void) {
+    uint64_t z = (random_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void fenwick_add(RunQueue *rq, int slot, long tickets) {
+    for (; slot <= rq->capacity; slot += slot & -slot) {
+        rq->fenwick[slot] += tickets;
+    }
+}
+
+/* The tickets of the slots 1 .. slot */
+static long fenwick_prefix(RunQueue *rq, int slot) {
+    long sum = 0;
+    for (; slot > 0; slot -= slot & -slot) {
+        sum += rq->fenwick[slot];
+    }
+    return sum;
+}
+
+/* The slot holding ticket number ticket, counting from 0 in slot order */
+static int fenwick_find(RunQueue *rq, long ticket) {
+    int slot = 0;
+    int step = 1;
+    while (step * 2 <= rq->capacity) {
+        step *= 2;
+    }
+    for (; step > 0; step /= 2) {
+        if (slot + step <= rq->capacity && rq->fenwick[slot + step] <= ticket) {
+            slot += step;
+            ticket -= rq->fenwick[slot];
+        }
+    }
+    return slot + 1;
+}
+
+/* Draws a process other than excluded, which may be NULL. There must be one. */
+static ProcessInfo *draw(RunQueue *rq, ProcessInfo *excluded) {
+    long tickets = rq->total_tickets - (excluded != NULL ? excluded->weight : 0);
+    assert(tickets > 0);
+    long ticket = next_random() % tickets;
+    // Skip the tickets of excluded.
+    if (excluded != NULL && ticket >= fenwick_prefix(rq, excluded->queue_slot - 1)) {
+        ticket += excluded->weight;
+    }
+    return rq->slots[fenwick_find(rq, ticket)];
+}
+
+/* Doubles the slots once they are all taken. The slots keep their numbers, so the draws are
+ * the same as if there had been that many slots from the start. */
+static void grow(RunQueue *rq) {
+    int old_capacity = rq->capacity;
+    rq->capacity = old_capacity > 0 ? old_capacity * 2 : LOTTERY_INITIAL_SLOTS;
+    rq->slots = (ProcessInfo **) realloc(rq->slots, sizeof(ProcessInfo *) * (rq->capacity + 1));
+    free(rq->fenwick);
+    rq->fenwick = (long *) calloc(rq->capacity + 1, sizeof(long));
+    for (int slot = 1; slot <= rq->capacity; slot++) {
+        if (slot > old_capacity) {
+            rq->slots[slot] = NULL;
+        } else if (rq->slots[slot] != NULL) {
+            rq->fenwick[slot] += rq->slots[slot]->weight;
+        }
+        int parent = slot + (slot & -slot);
+        if (parent <= rq->capacity) {
+            rq->fenwick[parent] += rq->fenwick[slot];
+        }
+    }
+    rq->free_slots = (int *) realloc(rq->free_slots, sizeof(int) * rq->capacity);
+    // The lowest slots are handed out first.
+    for (int slot = rq->capacity; slot > old_capacity; slot--) {
+        rq->free_slots[rq->free_count++] = slot;
+    }
+}
+
+static void set_strategy_LOTTERY(int num_process) {
+    (void) num_process; // The slots are doubled when they are all taken instead.
+    run_queues = (RunQueue *) calloc(num_cpus, sizeof(RunQueue));
+    random_state = lottery_seed;
+}
+
+static void add_process_LOTTERY(ProcessInfo *p) {
+    RunQueue *rq = &run_queues[current_cpu];
+    if (rq->free_count == 0) {
+        grow(rq);
+    }
+    p->queue_slot = rq->free_slots[--rq->free_count];
+    rq->slots[p->queue_slot] = p;
+    fenwick_add(rq, p->queue_slot, p->weight);
+    rq->total_tickets += p->weight;
+    rq->process_count++;
+}
+
+static void release_slot(RunQueue *rq, ProcessInfo *p) {
+    fenwick_add(rq, p->queue_slot, -p->weight);
+    rq->total_tickets -= p->weight;
+    rq->slots[p->queue_slot] = NULL;
+    rq->free_slots[rq->free_count++] = p->queue_slot;
+    p->queue_slot = -1;
+    rq->process_count--;
+}
+
+static void remove_current_process_LOTTERY(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    assert(rq->running != NULL);
+    release_slot(rq, rq->running);
+    rq->running = NULL;
+}
+
+static void timeslice_over_LOTTERY(long now) {
+    (void) now;
+    RunQueue *rq = &run_queues[current_cpu];
+    if (rq->running != NULL) {
+        rq->resched = true;
+    }
+}
+
+static void context_switch_LOTTERY(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    ProcessInfo *next = rq->running;
+    if ((rq->running == NULL || rq->resched) && rq->process_count > 0) {
+        next = draw(rq, NULL);
+    }
+    rq->resched = false;
+    if (next == rq->running) {
+        return;
+    }
+    if (rq->running != NULL) {
+        suspend_process(rq->running->pid);
+    }
+    resume_process(next->pid);
+    rq->running = next;
+}
+
+static bool scheduler_empty_LOTTERY(void) {
+    return run_queues[current_cpu].process_count == 0;
+}
+
+static int queue_length_LOTTERY(void) {
+    return run_queues[current_cpu].process_count;
+}
+
+static ProcessInfo *steal_process_LOTTERY(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    if (rq->process_count == (rq->running != NULL ? 1 : 0)) {
+        return NULL;
+    }
+    ProcessInfo *stolen = draw(rq, rq->running);
+    release_slot(rq, stolen);
+    return stolen;
+}
+
+static int timeslice_length_LOTTERY(void) {
+    return rr_quantum;
+}
+
+const SchedulerOps LOTTERY_ops = {
+    .name = "LOTTERY",
+    .set_strategy = set_strategy_LOTTERY,
+    .add_process = add_process_LOTTERY,
+    .remove_current_process = remove_current_process_LOTTERY,
+    .timeslice_over = timeslice_over_LOTTERY,
+    .timeslice_length = timeslice_length_LOTTERY,
+    .context_switch = context_switch_LOTTERY,
+    .scheduler_empty = scheduler_empty_LOTTERY,
+    .queue_length = queue_length_LOTTERY,
+    .steal_process = steal_process_LOTTERY,
+};
@@ -0,0 +1,219 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "scheduler.h"
+
+/* Multi-level feedback queue.
+ *
+ * Level 0 has the highest priority. Each level is a circular list through rr_next and rr_prev,
+ * in the order its processes take turns, and the process at its head runs next. A process
+ * arrives at level 0 and moves one level down once it has run for the quantum of its level;
+ * at the lowest level, it goes to the back of the queue instead. Every mlfq_boost_period
+ * units, every process moves back to level 0, so that the long ones don't starve. A boost
+ * splices the lower levels onto level 0 and counts itself in the generation of the run queue;
+ * the level and slices of a process stamped with an older generation are brought up to date
+ * (level 0, no slices) the next time they are looked at, so a boost doesn't visit the processes.
+ *
+ * Time is counted in time slices of timeslice_length_MLFQ() units, the greatest common
+ * divisor of the quanta and the boost period, so that the time slice timer used by RR
+ * drives it too. Like in RR, a time slice is charged to the process running when it ends.
+ */
+
+int mlfq_levels = 3;
+int mlfq_quanta[MLFQ_MAX_LEVELS] = {100, 200, 400};
+int mlfq_boost_period = 5000;
+
+typedef struct RunQueue {
+    ProcessInfo *heads[MLFQ_MAX_LEVELS];
+    ProcessInfo *running; // The process resumed at the last context switch, until it terminates
+    int process_count;
+    int slices_since_boost; // Counted only while a process is queued
+    int generation; // Boosts so far
+} RunQueue;
+
+static RunQueue *run_queues; // One per CPU
+static int slice_length;
+
+static int gcd(int lhs, int rhs) {
+    while (rhs != 0) {
+        int rest = lhs % rhs;
+        lhs = rhs;
+        rhs = rest;
+    }
+    return lhs;
+}
+
+static int timeslice_length_MLFQ(void) {
+    int length = mlfq_boost_period;
+    for (int level = 0; level < mlfq_levels; level++) {
+        length = gcd(length, mlfq_quanta[level]);
+    }
+    return length;
+}
+
+/* Moves p to level 0 with a fresh quantum if the run queue has been boosted since its level was
+ * set. The boost has already put it in the list of level 0. */
+static void catch_up(RunQueue *rq, ProcessInfo *p) {
+    if (p->mlfq_generation != rq->generation) {
+        p->mlfq_level = p->mlfq_slices = 0;
+        p->mlfq_generation = rq->generation;
+    }
+}
+
+static void link_at_back(RunQueue *rq, ProcessInfo *p) {
+    ProcessInfo *head = rq->heads[p->mlfq_level];
+    if (head == NULL) {
+        p->rr_next = p->rr_prev = p;
+        rq->heads[p->mlfq_level] = p;
+    } else {
+        p->rr_next = head;
+        p->rr_prev = head->rr_prev;
+        head->rr_prev->rr_next = p;
+        head->rr_prev = p;
+    }
+}
+
+static void unlink_process(RunQueue *rq, ProcessInfo *p) {
+    if (p->rr_next == p) {
+        rq->heads[p->mlfq_level] = NULL;
+        return;
+    }
+    p->rr_prev->rr_next = p->rr_next;
+    p->rr_next->rr_prev = p->rr_prev;
+    if (rq->heads[p->mlfq_level] == p) {
+        rq->heads[p->mlfq_level] = p->rr_next;
+    }
+}
+
+static void set_strategy_MLFQ(int unused) {
+    (void) unused;
+    run_queues = (RunQueue *) calloc(num_cpus, sizeof(RunQueue));
+    slice_length = timeslice_length_MLFQ();
+}
+
+static void add_process_MLFQ(ProcessInfo *p) {
+    RunQueue *rq = &run_queues[current_cpu];
+    /* A new process is at level 0. A process stolen from another CPU keeps its level and the
+     * time it has run there, which steal_process_MLFQ() brought up to date with the boosts of
+     * that CPU, so its stamp only has to count those of this one from now on. */
+    p->mlfq_generation = rq->generation;
+    link_at_back(rq, p);
+    rq->process_count++;
+}
+
+static void remove_current_process_MLFQ(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    assert(rq->running != NULL);
+    catch_up(rq, rq->running);
+    unlink_process(rq, rq->running);
+    rq->running = NULL;
+    rq->process_count--;
+}
+
+/* Moves every process to level 0, keeping the order of the levels, with a fresh quantum: the
+ * list of each lower level is spliced after the back of level 0, and the processes catch up
+ * with the new generation when they are next looked at. */
+static void boost(RunQueue *rq) {
+    for (int level = 1; level < mlfq_levels; level++) {
+        ProcessInfo *head = rq->heads[level];
+        if (head == NULL) {
+            continue;
+        }
+        rq->heads[level] = NULL;
+        ProcessInfo *front = rq->heads[0];
+        if (front == NULL) {
+            rq->heads[0] = head;
+            continue;
+        }
+        ProcessInfo *back = head->rr_prev;
+        front->rr_prev->rr_next = head;
+        head->rr_prev = front->rr_prev;
+        back->rr_next = front;
+        front->rr_prev = back;
+    }
+    rq->generation++;
+}
+
+static void timeslice_over_MLFQ(long now) {
+    (void) now;
+    RunQueue *rq = &run_queues[current_cpu];
+    ProcessInfo *p = rq->running;
+    if (p != NULL) {
+        catch_up(rq, p);
+        if (++p->mlfq_slices * slice_length >= mlfq_quanta[p->mlfq_level]) {
+            unlink_process(rq, p);
+            if (p->mlfq_level < mlfq_levels - 1) {
+                p->mlfq_level++;
+            }
+            p->mlfq_slices = 0;
+            link_at_back(rq, p);
+        }
+    }
+    if (rq->process_count > 0 && ++rq->slices_since_boost * slice_length >= mlfq_boost_period) {
+        rq->slices_since_boost = 0;
+        boost(rq);
+    }
+}
+
+/* The head of the highest level that isn't empty */
+static ProcessInfo *next_process(RunQueue *rq) {
+    for (int level = 0; level < mlfq_levels; level++) {
+        if (rq->heads[level] != NULL) {
+            return rq->heads[level];
+        }
+    }
+    return NULL;
+}
+
+static void context_switch_MLFQ(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    ProcessInfo *next = next_process(rq);
+    if (next == rq->running) {
+        return;
+    }
+    if (rq->running != NULL) {
+        suspend_process(rq->running->pid);
+    }
+    if (next != NULL) {
+        resume_process(next->pid);
+    }
+    rq->running = next;
+}
+
+static bool scheduler_empty_MLFQ(void) {
+    return run_queues[current_cpu].process_count == 0;
+}
+
+static int queue_length_MLFQ(void) {
+    return run_queues[current_cpu].process_count;
+}
+
+static ProcessInfo *steal_process_MLFQ(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    for (int level = 0; level < mlfq_levels; level++) {
+        ProcessInfo *head = rq->heads[level];
+        if (head == NULL) {
+            continue;
+        }
+        ProcessInfo *stolen = head != rq->running ? head : head->rr_next;
+        if (stolen != rq->running) {
+            catch_up(rq, stolen);
+            unlink_process(rq, stolen);
+            rq->process_count--;
+            return stolen;
+        }
+    }
+    return NULL;
+}
+
+const SchedulerOps MLFQ_ops = {
+    .name = "MLFQ",
+    .set_strategy = set_strategy_MLFQ,
+    .add_process = add_process_MLFQ,
+    .remove_current_process = remove_current_process_MLFQ,
+    .timeslice_over = timeslice_over_MLFQ,
+    .timeslice_length = timeslice_length_MLFQ,
+    .context_switch = context_switch_MLFQ,
+    .scheduler_empty = scheduler_empty_MLFQ,
+    .queue_length = queue_length_MLFQ,
+    .steal_process = steal_process_MLFQ,
+};
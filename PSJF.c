@@ -1,51 +1,52 @@
 #include "scheduler.h"
-#include <assert.h>
 #include <stdlib.h>
 
-#include <sys/types.h>
-#include <signal.h>
+/* Preemptive shortest job first: the run queue of preemptive.c, ordered by the remaining time
+ * (aged with --aging, predicted with --predict).
+ */
 
-static Heap pq;
-static ProcessInfo *active_process = NULL;
-static int last_context_switch_time = 0;
-static int current_time = 0;
+static PreemptiveQueue *run_queues; // One per CPU
 
-/* Invariant: the top of heap should be always the currently running process
- * after context_switch_PSJF() is called.
- */
+static void add_process_PSJF(ProcessInfo *new_process) {
+    PreemptiveQueue *rq = &run_queues[current_cpu];
+    preemptive_arrive(rq, new_process);
+    heap_insert(&rq->pq, new_process);
+}
+
+static void set_strategy_PSJF(int num_process) {
+    run_queues = (PreemptiveQueue *) calloc(num_cpus, sizeof(PreemptiveQueue));
+    for (int cpu = 0; cpu < num_cpus; cpu++) {
+        preemptive_init(&run_queues[cpu], num_process, aging_rate > 0 ? AGED_KEY : REMAINING_TIME_KEY);
+    }
+}
 
-void add_process_PSJF(ProcessInfo *new_process) {
-    assert(active_process == heap_top(&pq));
-    current_time = new_process->arrival_time;
-    active_process->remaining_time -= (current_time - last_context_switch_time);
-    // active_process doesn't need to be popped as deducting its remaining time 
-    // does not require updating the heap.
-    heap_insert(&pq, new_process);
+static void remove_current_process_PSJF(void) {
+    predict_terminated(preemptive_terminate(&run_queues[current_cpu]));
 }
 
-void set_strategy_PSJF(int num_process) {
-    heap_init(&pq, num_process);
+static void context_switch_PSJF(void) {
+    preemptive_context_switch(&run_queues[current_cpu]);
 }
 
-void remove_current_process_PSJF(void) {
-    assert(active_process == heap_top(&pq));
-    int time_passed = active_process->remaining_time;
-    current_time += time_passed;
-    active_process = NULL;
-    heap_pop(&pq);
+static bool scheduler_empty_PSJF(void) {
+    return preemptive_empty(&run_queues[current_cpu]);
 }
 
-void context_switch_PSJF(void) {
-    if (!heap_empty(&pq) && active_process != heap_top(&pq)){
-        if (active_process != NULL){
-            suspend_process(active_process->pid);
-        }
-        active_process = heap_top(&pq);
-        resume_process(active_process->pid);
-    }
-    last_context_switch_time = current_time;
+static int queue_length_PSJF(void) {
+    return heap_size(&run_queues[current_cpu].pq);
 }
 
-bool scheduler_empty_PSJF(void) {
-     return active_process == NULL && heap_empty(&pq);
+static ProcessInfo *steal_process_PSJF(void) {
+    return preemptive_steal(&run_queues[current_cpu]);
 }
+
+const SchedulerOps PSJF_ops = {
+    .name = "PSJF",
+    .set_strategy = set_strategy_PSJF,
+    .add_process = add_process_PSJF,
+    .remove_current_process = remove_current_process_PSJF,
+    .context_switch = context_switch_PSJF,
+    .scheduler_empty = scheduler_empty_PSJF,
+    .queue_length = queue_length_PSJF,
+    .steal_process = steal_process_PSJF,
+};
@@ -4,68 +4,180 @@
 #include <string.h>
 #include "scheduler.h"
 
-static ProcessInfo **pq;
-static int current_process_id = -1; // The index of the process in pq that the scheduler runs when context_switch_RR() is called.
-static int previous_active_id = -1; // The index of the process in pq that the scheduler stops when context_switch_RR() is called.
-static int process_count = 0;
-
-static int advance(int n) {
-    if (n < 0) {
-        return n;
+/* Round robin, with a time slice of --quantum N time units (RR_TIMES_OF_UNIT by default).
+ *
+ * With --quantum adaptive, the quantum is picked from the run times of the last
+ * RR_ADAPTIVE_WINDOW processes that terminated, so that RR_ADAPTIVE_PERCENTILE percent of them
+ * would have run in one time slice, within RR_MIN_QUANTUM and RR_MAX_QUANTUM. A new quantum
+ * applies from the next time slice on. A process that has at most rr_quantum / RR_GRACE_DIVISOR
+ * units left when its time slice ends is given a grace extension: it keeps running instead of
+ * waiting a whole round just to finish. The time left is charged from a clock each CPU keeps
+ * from the events it sees, as PSJF.c does: arrivals, terminations, and the ends of the time
+ * slices, whose times the dispatcher gives. The clock never goes back, even when a late timer
+ * makes the events of a real run come out of order. */
+
+#define RR_ADAPTIVE_WINDOW 32
+#define RR_ADAPTIVE_PERCENTILE 80
+#define RR_MIN_QUANTUM 50
+#define RR_MAX_QUANTUM 2000
+#define RR_GRACE_DIVISOR 5
+
+int rr_quantum = RR_TIMES_OF_UNIT;
+bool rr_adaptive = false;
+
+/* The run queue is a circular doubly-linked list through rr_next and rr_prev of ProcessInfo.
+ * Following rr_next is the order processes take turns, the same order as increasing indices
+ * in the array it used to be; a process that arrives is inserted just before the current one,
+ * so it gets its turn after every other process has had one. */
+typedef struct RunQueue {
+    ProcessInfo *current_process; // The process that the scheduler runs when context_switch_RR() is called.
+    ProcessInfo *previous_active; // The process that the scheduler stops when context_switch_RR() is called.
+    int process_count;
+    long now; // The time of the last event of this CPU
+    long run_start; // When current_process was last charged for the time it ran
+} RunQueue;
+
+static RunQueue *run_queues; // One per CPU
+static int run_times[RR_ADAPTIVE_WINDOW]; // Of the last processes that terminated, a ring
+static int run_time_count;
+
+static int int_cmp(const void *lhs, const void *rhs) {
+    return *(const int *) lhs - *(const int *) rhs;
+}
+
+/* Picks the adaptive quantum after a process that ran for run_time has terminated. */
+static void adapt_quantum(int run_time) {
+    run_times[run_time_count++ % RR_ADAPTIVE_WINDOW] = run_time;
+    int n = run_time_count < RR_ADAPTIVE_WINDOW ? run_time_count : RR_ADAPTIVE_WINDOW;
+    int sorted[RR_ADAPTIVE_WINDOW];
+    memcpy(sorted, run_times, sizeof(int) * n);
+    qsort(sorted, n, sizeof(int), int_cmp);
+    int quantum = sorted[(n * RR_ADAPTIVE_PERCENTILE + 99) / 100 - 1];
+    if (quantum < RR_MIN_QUANTUM) {
+        quantum = RR_MIN_QUANTUM;
+    } else if (quantum > RR_MAX_QUANTUM) {
+        quantum = RR_MAX_QUANTUM;
     }
-    n++;
-    if (n == process_count) {
-        n = 0;
+    rr_quantum = quantum;
+}
+
+static void unlink_process(ProcessInfo *p) {
+    p->rr_prev->rr_next = p->rr_next;
+    p->rr_next->rr_prev = p->rr_prev;
+}
+
+/* Moves the clock of rq to now, unless it is already past it. */
+static void advance_clock(RunQueue *rq, long now) {
+    if (now > rq->now) {
+        rq->now = now;
     }
-    return n;
 }
 
-void set_strategy_RR(int num_process) {
-    pq = (ProcessInfo **) malloc(sizeof(ProcessInfo *) * num_process);
+static void set_strategy_RR(int unused) {
+    (void) unused;
+    run_queues = (RunQueue *) calloc(num_cpus, sizeof(RunQueue));
 }
 
-void add_process_RR(ProcessInfo *p) {
-    if (process_count == 0){
-        assert(previous_active_id < 0); // makes sure the last event is remove_current_process().
-        current_process_id = 0;
-        pq[current_process_id] = p;
+static void add_process_RR(ProcessInfo *p) {
+    RunQueue *rq = &run_queues[current_cpu];
+    advance_clock(rq, p->arrival_time);
+    if (rq->process_count == 0){
+        assert(rq->previous_active == NULL); // makes sure the last event is remove_current_process().
+        p->rr_next = p->rr_prev = p;
+        rq->current_process = p;
+        rq->run_start = rq->now;
     } else {
-        for(int i = process_count - 1; i >= current_process_id; i--){ 
-            pq[i+1] = pq[i];
-	}
-        pq[current_process_id] = p;
-        current_process_id++;
+        ProcessInfo *current = rq->current_process;
+        p->rr_next = current;
+        p->rr_prev = current->rr_prev;
+        current->rr_prev->rr_next = p;
+        current->rr_prev = p;
     }
-    process_count++;
+    rq->process_count++;
 }
 
-void remove_current_process_RR(void) {
-    for(int i = current_process_id + 1; i < process_count; i++){
-        pq[i-1] = pq[i];
+static void remove_current_process_RR(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    ProcessInfo *current = rq->current_process;
+    // It may have been charged a little more than it needed, when the time slice timer was late.
+    if (current->remaining_time > 0) {
+        advance_clock(rq, rq->run_start + current->remaining_time);
     }
-    previous_active_id = -1;
-    process_count--;
-    if (process_count == 0) {
-        current_process_id = -1;
-    } else if (current_process_id == process_count) {
-        current_process_id = 0;
+    current->remaining_time = 0;
+    unlink_process(current);
+    rq->previous_active = NULL;
+    rq->process_count--;
+    rq->current_process = rq->process_count == 0 ? NULL : current->rr_next;
+    rq->run_start = rq->now;
+    if (rr_adaptive) {
+        adapt_quantum(current->time_needed);
     }
 }
 
-void timeslice_over_RR(void) {
-    previous_active_id = current_process_id;
-    current_process_id = advance(current_process_id);
+static void timeslice_over_RR(long now) {
+    RunQueue *rq = &run_queues[current_cpu];
+    advance_clock(rq, now);
+    rq->previous_active = rq->current_process;
+    ProcessInfo *current = rq->current_process;
+    if (current == NULL) {
+        return;
+    }
+    current->remaining_time -= rq->now - rq->run_start;
+    rq->run_start = rq->now;
+    if (rr_adaptive && current->remaining_time <= rr_quantum / RR_GRACE_DIVISOR) {
+        rq->previous_active = NULL; // Grace extension
+        return;
+    }
+    rq->current_process = current->rr_next;
 }
 
-void context_switch_RR(void) {
-    if (previous_active_id >= 0) {
-        suspend_process(pq[previous_active_id]->pid);
+static void context_switch_RR(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    if (rq->previous_active != NULL) {
+        suspend_process(rq->previous_active->pid);
     }
-    if (current_process_id >= 0) {
-        resume_process(pq[current_process_id]->pid);
+    if (rq->current_process != NULL) {
+        resume_process(rq->current_process->pid);
     }
 }
 
-bool scheduler_empty_RR(void) {
-    return process_count == 0 && current_process_id < 0;
+static bool scheduler_empty_RR(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    return rq->process_count == 0 && rq->current_process == NULL;
+}
+
+static int queue_length_RR(void) {
+    return run_queues[current_cpu].process_count;
 }
+
+static ProcessInfo *steal_process_RR(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    if (rq->process_count < 2) {
+        return NULL;
+    }
+    // Take the process that would run after the current one.
+    ProcessInfo *stolen = rq->current_process->rr_next;
+    unlink_process(stolen);
+    rq->process_count--;
+    if (rq->previous_active == stolen) {
+        rq->previous_active = NULL; // It is resumed on its new CPU instead.
+    }
+    return stolen;
+}
+
+static int timeslice_length_RR(void) {
+    return rr_quantum;
+}
+
+const SchedulerOps RR_ops = {
+    .name = "RR",
+    .set_strategy = set_strategy_RR,
+    .add_process = add_process_RR,
+    .remove_current_process = remove_current_process_RR,
+    .timeslice_over = timeslice_over_RR,
+    .timeslice_length = timeslice_length_RR,
+    .context_switch = context_switch_RR,
+    .scheduler_empty = scheduler_empty_RR,
+    .queue_length = queue_length_RR,
+    .steal_process = steal_process_RR,
+};
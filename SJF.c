@@ -4,30 +4,72 @@
 #include <sys/types.h>
 #include <signal.h>
 
-static Heap inactive_heap;
-static ProcessInfo *active_process = NULL;
+typedef struct RunQueue {
+     Heap inactive_heap;
+     ProcessInfo *active_process;
+} RunQueue;
 
-void add_process_SJF(ProcessInfo *new_process) {
-     heap_insert(&inactive_heap, new_process);
+static RunQueue *run_queues; // One per CPU
+
+static void add_process_SJF(ProcessInfo *new_process) {
+     heap_insert(&run_queues[current_cpu].inactive_heap, new_process);
 }
 
-void set_strategy_SJF(int num_process) {
-     heap_init(&inactive_heap, num_process);
+static void set_strategy_SJF(int num_process) {
+     run_queues = (RunQueue *) malloc(sizeof(RunQueue) * num_cpus);
+     for (int cpu = 0; cpu < num_cpus; cpu++) {
+          // A waiting process never runs, so its aged key stays the same.
+          heap_init_key(&run_queues[cpu].inactive_heap, num_process, aging_rate > 0 ? AGED_KEY : REMAINING_TIME_KEY);
+          run_queues[cpu].active_process = NULL;
+     }
 }
 
-void remove_current_process_SJF(void) {
-     active_process = NULL;
+static void remove_current_process_SJF(void) {
+     RunQueue *rq = &run_queues[current_cpu];
+     predict_terminated(rq->active_process);
+     rq->active_process = NULL;
 }
 
-void context_switch_SJF(void) {
-     if (active_process != NULL) {
+static void context_switch_SJF(void) {
+     RunQueue *rq = &run_queues[current_cpu];
+     if (rq->active_process != NULL) {
           return; // No preemption in SJF
      }
-     active_process = heap_top(&inactive_heap);
-     heap_pop(&inactive_heap);
-     resume_process(active_process->pid);
+     if (heap_empty(&rq->inactive_heap)) {
+          return; // Idle until the next process arrives
+     }
+     rq->active_process = heap_top(&rq->inactive_heap);
+     heap_pop(&rq->inactive_heap);
+     resume_process(rq->active_process->pid);
+}
+
+static bool scheduler_empty_SJF(void) {
+     RunQueue *rq = &run_queues[current_cpu];
+     return heap_size(&rq->inactive_heap) == 0 && rq->active_process == NULL;
 }
 
-bool scheduler_empty_SJF(void) {
-     return heap_size(&inactive_heap) == 0 && active_process == NULL;
+static int queue_length_SJF(void) {
+     RunQueue *rq = &run_queues[current_cpu];
+     return heap_size(&rq->inactive_heap) + (rq->active_process != NULL);
 }
+
+static ProcessInfo *steal_process_SJF(void) {
+     RunQueue *rq = &run_queues[current_cpu];
+     if (heap_empty(&rq->inactive_heap)) {
+          return NULL;
+     }
+     ProcessInfo *stolen = heap_top(&rq->inactive_heap);
+     heap_pop(&rq->inactive_heap);
+     return stolen;
+}
+
+const SchedulerOps SJF_ops = {
+     .name = "SJF",
+     .set_strategy = set_strategy_SJF,
+     .add_process = add_process_SJF,
+     .remove_current_process = remove_current_process_SJF,
+     .context_switch = context_switch_SJF,
+     .scheduler_empty = scheduler_empty_SJF,
+     .queue_length = queue_length_SJF,
+     .steal_process = steal_process_SJF,
+};
@@ -0,0 +1,132 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "scheduler.h"
+
+/* Stride scheduling.
+ *
+ * Every process has a stride, STRIDE1 divided by its tickets, and a pass, kept in vruntime.
+ * Each time slice, the process with the least pass runs, and its pass moves on by its stride
+ * when the time slice ends, so over any number of time slices, each process gets its share of
+ * them to within one. The waiting processes of a CPU are kept in the red-black tree of rbtree.c
+ * and the running one is out of it, as in CFS.c. A process that arrives starts at the least
+ * pass of its CPU, so it doesn't make up for the time before it arrived.
+ */
+
+#define STRIDE1 (1L << 32) // So that the stride is at least 2 for any number of tickets
+
+typedef struct RunQueue {
+    RbTree waiting;
+    ProcessInfo *running;
+    bool resched; // A time slice has ended since the last context switch
+    long min_pass; // Never goes down
+    int process_count; // In the tree or running
+} RunQueue;
+
+static RunQueue *run_queues; // One per CPU
+
+static void update_min_pass(RunQueue *rq) {
+    ProcessInfo *first = rbtree_first(&rq->waiting);
+    long least = rq->min_pass;
+    if (rq->running != NULL) {
+        least = rq->running->vruntime;
+    }
+    if (first != NULL && (rq->running == NULL || first->vruntime < least)) {
+        least = first->vruntime;
+    }
+    if (least > rq->min_pass) {
+        rq->min_pass = least;
+    }
+}
+
+static void set_strategy_STRIDE(int unused) {
+    (void) unused;
+    run_queues = (RunQueue *) calloc(num_cpus, sizeof(RunQueue));
+    for (int cpu = 0; cpu < num_cpus; cpu++) {
+        rbtree_init(&run_queues[cpu].waiting);
+    }
+}
+
+static void add_process_STRIDE(ProcessInfo *p) {
+    RunQueue *rq = &run_queues[current_cpu];
+    // A process stolen from another CPU keeps its pass unless it is behind this one.
+    if (p->vruntime < rq->min_pass) {
+        p->vruntime = rq->min_pass;
+    }
+    rbtree_insert(&rq->waiting, p);
+    rq->process_count++;
+}
+
+static void remove_current_process_STRIDE(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    assert(rq->running != NULL);
+    rq->running = NULL;
+    rq->process_count--;
+    update_min_pass(rq);
+}
+
+static void timeslice_over_STRIDE(long now) {
+    (void) now;
+    RunQueue *rq = &run_queues[current_cpu];
+    if (rq->running != NULL) {
+        rq->running->vruntime += STRIDE1 / rq->running->weight;
+        rq->resched = true;
+        update_min_pass(rq);
+    }
+}
+
+static void context_switch_STRIDE(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    ProcessInfo *first = rbtree_first(&rq->waiting);
+    ProcessInfo *next = rq->running;
+    if (rq->running == NULL || (rq->resched && first != NULL && rbtree_before(first, rq->running))) {
+        next = first;
+    }
+    rq->resched = false;
+    if (next == rq->running) {
+        return;
+    }
+    if (rq->running != NULL) {
+        suspend_process(rq->running->pid);
+        rbtree_insert(&rq->waiting, rq->running);
+    }
+    if (next != NULL) {
+        rbtree_erase(&rq->waiting, next);
+        resume_process(next->pid);
+    }
+    rq->running = next;
+}
+
+static bool scheduler_empty_STRIDE(void) {
+    return run_queues[current_cpu].process_count == 0;
+}
+
+static int queue_length_STRIDE(void) {
+    return run_queues[current_cpu].process_count;
+}
+
+static ProcessInfo *steal_process_STRIDE(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    ProcessInfo *stolen = rbtree_first(&rq->waiting);
+    if (stolen != NULL) {
+        rbtree_erase(&rq->waiting, stolen);
+        rq->process_count--;
+    }
+    return stolen;
+}
+
+static int timeslice_length_STRIDE(void) {
+    return rr_quantum;
+}
+
+const SchedulerOps STRIDE_ops = {
+    .name = "STRIDE",
+    .set_strategy = set_strategy_STRIDE,
+    .add_process = add_process_STRIDE,
+    .remove_current_process = remove_current_process_STRIDE,
+    .timeslice_over = timeslice_over_STRIDE,
+    .timeslice_length = timeslice_length_STRIDE,
+    .context_switch = context_switch_STRIDE,
+    .scheduler_empty = scheduler_empty_STRIDE,
+    .queue_length = queue_length_STRIDE,
+    .steal_process = steal_process_STRIDE,
+};
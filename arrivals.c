@@ -0,0 +1,345 @@
+#define _GNU_SOURCE // pipe2()
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "scheduler.h"
+
+/* The arrival queue: the processes of the input, in the order they arrive.
+ *
+ * Without --stream, the whole input has been read into an array beforehand, and
+ * arrival_queue_init() sorts it by arrival time, stably so that processes arriving together
+ * keep their input order. An input that is already sorted, as most are, is only checked; any
+ * other is sorted by an LSD radix sort of (arrival time, input position) pairs, one pass per
+ * 11-bit digit of the arrival times in which they differ, which leaves the input positions in
+ * the order they arrive. The queue then walks those positions, and the array itself stays in
+ * input order, in which the processes are reported after the run.
+ *
+ * With --stream, the processes are read from the input one at a time, and every process has an
+ * allocation of its own, freed by release_process() once it has terminated and been reported.
+ * Up to ARRIVAL_WINDOW processes are read ahead into a min-heap by (arrival time, input
+ * position), so the next to arrive is the first of the heap: an input out of order by fewer
+ * processes than that arrives in order. A process that comes later than that, with an arrival
+ * time before that of a process that has already arrived, arrives at once, its arrival time
+ * moved to the last one. So the memory is that of the processes that have arrived and not
+ * terminated and of the window, and the first one can run before the rest of the input has
+ * been read.
+ *
+ * Outside the simulator, the input is read by a thread of its own, so that waiting for a slow
+ * input never delays the timers and children of the event loop. It parses up to ARRIVAL_WINDOW
+ * processes into a ring and writes a byte to a pipe when the ring was empty; the event loop
+ * watches the read end, given by arrival_input_fd(), and arrival_queue_poll() moves the ring to
+ * the heap. The heap is then the same as if it had been read in place, but the next arrival is
+ * only known once the heap is full or the whole input has been received, which
+ * arrival_queue_ready() tells. The thread keeps the priority of the scheduler, so that the
+ * input keeps up with the arrivals, and parses at most a ring ahead of them.
+ */
+
+#define ARRIVAL_WINDOW 1024
+#define ARRIVAL_DIGIT_BITS 11 // So that the counts of a digit fit in the L1 cache
+#define ARRIVAL_DIGIT_VALUES (1 << ARRIVAL_DIGIT_BITS)
+#define ARRIVAL_DIGITS ((32 + ARRIVAL_DIGIT_BITS - 1) / ARRIVAL_DIGIT_BITS)
+
+typedef struct Pending {
+    int arrival_time;
+    int position; // In the input, so that the heap is stable
+    ProcessInfo *process;
+} Pending;
+
+static ProcessInfo *processes; // The whole input, or NULL when streaming
+static uint32_t *arrival_order; // The positions in processes in the order they arrive, or NULL if it is sorted
+static Pending *pending; // When streaming, the min-heap of the processes read ahead
+static int pending_count, read_count;
+static int num_process, arrived;
+static int previous_arrival_time; // Of the last process that arrived, or 0
+static int late_count; // Of the processes that arrived late
+static ProcessInfo **ring; // Parsed by the reader thread, NULL without it
+static int ring_head, ring_count;
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ring_not_full = PTHREAD_COND_INITIALIZER;
+static int input_pipe[2] = {-1, -1}; // Written by the reader thread when the ring is no longer empty
+
+/* The arrival time of p as an unsigned key, ordered as the signed arrival times are */
+static uint32_t arrival_key(const ProcessInfo *p) {
+    return (uint32_t) p->arrival_time ^ 0x80000000u;
+}
+
+static bool sorted_by_arrival(const ProcessInfo *all, int n) {
+    for (int i = 1; i < n; i++) {
+        if (all[i].arrival_time < all[i - 1].arrival_time) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Returns the positions in all in the order they arrive, stably. Each pair holds the key in its
+ * upper half and the input position in its lower half, so that after sorting by the key, pair i
+ * tells which process arrives i-th. */
+static uint32_t *radix_sort_by_arrival(const ProcessInfo *all, int n) {
+    uint64_t *pairs = (uint64_t *) malloc(n * sizeof(uint64_t));
+    uint64_t *sorted = (uint64_t *) malloc(n * sizeof(uint64_t));
+    static int counts[ARRIVAL_DIGITS][ARRIVAL_DIGIT_VALUES];
+    memset(counts, 0, sizeof(counts));
+    for (int i = 0; i < n; i++) {
+        uint32_t key = arrival_key(&all[i]);
+        pairs[i] = (uint64_t) key << 32 | (uint32_t) i;
+        for (int digit = 0; digit < ARRIVAL_DIGITS; digit++) {
+            counts[digit][key >> (digit * ARRIVAL_DIGIT_BITS) & (ARRIVAL_DIGIT_VALUES - 1)]++;
+        }
+    }
+    for (int digit = 0; digit < ARRIVAL_DIGITS; digit++) {
+        int shift = 32 + digit * ARRIVAL_DIGIT_BITS;
+        if (counts[digit][pairs[0] >> shift & (ARRIVAL_DIGIT_VALUES - 1)] == n) {
+            continue; // All the keys have the same digit
+        }
+        int start = 0;
+        for (int bucket = 0; bucket < ARRIVAL_DIGIT_VALUES; bucket++) {
+            int count = counts[digit][bucket];
+            counts[digit][bucket] = start;
+            start += count;
+        }
+        for (int i = 0; i < n; i++) {
+            sorted[counts[digit][pairs[i] >> shift & (ARRIVAL_DIGIT_VALUES - 1)]++] = pairs[i];
+        }
+        uint64_t *swap = pairs;
+        pairs = sorted;
+        sorted = swap;
+    }
+    free(sorted);
+
+    // The positions take half the room of the pairs, so they are packed in place.
+    uint32_t *order = (uint32_t *) pairs;
+    for (int i = 0; i < n; i++) {
+        order[i] = (uint32_t) pairs[i];
+    }
+    return (uint32_t *) realloc(order, n * sizeof(uint32_t));
+}
+
+void arrival_queue_init(ProcessInfo *all, int n) {
+    processes = all;
+    num_process = n;
+    if (!sorted_by_arrival(all, n)) {
+        arrival_order = radix_sort_by_arrival(all, n);
+    }
+}
+
+static bool pending_before(const Pending *lhs, const Pending *rhs) {
+    return lhs->arrival_time < rhs->arrival_time
+            || (lhs->arrival_time == rhs->arrival_time && lhs->position < rhs->position);
+}
+
+static void pending_push(ProcessInfo *p) {
+    int i = pending_count++;
+    Pending new_pending = {p->arrival_time, read_count, p};
+    while (i > 0 && pending_before(&new_pending, &pending[(i - 1) / 2])) {
+        pending[i] = pending[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    pending[i] = new_pending;
+}
+
+static ProcessInfo *pending_pop(void) {
+    ProcessInfo *first = pending[0].process;
+    Pending last = pending[--pending_count];
+    int i = 0;
+    while (2 * i + 1 < pending_count) {
+        int child = 2 * i + 1;
+        if (child + 1 < pending_count && pending_before(&pending[child + 1], &pending[child])) {
+            child++;
+        }
+        if (!pending_before(&pending[child], &last)) {
+            break;
+        }
+        pending[i] = pending[child];
+        i = child;
+    }
+    pending[i] = last;
+    return first;
+}
+
+/* A process that comes after one with a later arrival time has arrived can't arrive in the
+ * past, so it arrives at once. */
+static void arrive_late(ProcessInfo *p) {
+    if (late_count++ == 0) {
+        fprintf(stderr, "%s: ready at %d but read after a process ready at %d arrived, so it arrives late; "
+                "the input is out of order by more than %d processes\n",
+                p->name, p->arrival_time, previous_arrival_time, ARRIVAL_WINDOW);
+    }
+    p->arrival_time = p->wait_origin = previous_arrival_time;
+}
+
+/* Moves a process that has been read to the heap. */
+static void receive(ProcessInfo *p) {
+    if (arrived > 0 && p->arrival_time < previous_arrival_time) {
+        arrive_late(p);
+    }
+    pending_push(p);
+    read_count++;
+}
+
+/* Reads ahead until the window is full or the input is read, or with the reader thread, takes
+ * what it has parsed until the window is full. */
+static void read_ahead(void) {
+    if (ring != NULL) {
+        pthread_mutex_lock(&ring_lock);
+        while (pending_count < ARRIVAL_WINDOW && ring_count > 0) {
+            receive(ring[ring_head]);
+            ring_head = (ring_head + 1) % ARRIVAL_WINDOW;
+            ring_count--;
+            pthread_cond_signal(&ring_not_full);
+        }
+        pthread_mutex_unlock(&ring_lock);
+        return;
+    }
+    while (pending_count < ARRIVAL_WINDOW && read_count < num_process) {
+        ProcessInfo *p = (ProcessInfo *) malloc(sizeof(ProcessInfo));
+        workload_next(p);
+        receive(p);
+        if (read_count == num_process) {
+            workload_close();
+        }
+    }
+}
+
+static void *read_input(void *unused) {
+    (void) unused;
+    for (int i = 0; i < num_process; i++) {
+        ProcessInfo *p = (ProcessInfo *) malloc(sizeof(ProcessInfo));
+        workload_next(p);
+        pthread_mutex_lock(&ring_lock);
+        while (ring_count == ARRIVAL_WINDOW) {
+            pthread_cond_wait(&ring_not_full, &ring_lock);
+        }
+        ring[(ring_head + ring_count) % ARRIVAL_WINDOW] = p;
+        bool was_empty = ring_count++ == 0;
+        pthread_mutex_unlock(&ring_lock);
+        // A ring that wasn't empty will be taken with the byte written for it.
+        char byte = 0;
+        if (was_empty && write(input_pipe[1], &byte, 1) == -1 && errno != EAGAIN) {
+            perror("Can't notify the scheduler of the input");
+            exit(1);
+        }
+    }
+    workload_close();
+    return NULL;
+}
+
+/* Starts the reader thread, with every signal blocked so that they all go to the event loop,
+ * and the scheduling policy of the caller, which a thread of a SCHED_RESET_ON_FORK one wouldn't
+ * inherit. */
+static void start_reader(void) {
+    ring = (ProcessInfo **) malloc(ARRIVAL_WINDOW * sizeof(ProcessInfo *));
+    if (pipe2(input_pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+        perror("Can't create the pipe of the input");
+        exit(1);
+    }
+    pthread_attr_t attr;
+    int policy;
+    struct sched_param param;
+    pthread_attr_init(&attr);
+    pthread_getschedparam(pthread_self(), &policy, &param);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, policy);
+    pthread_attr_setschedparam(&attr, &param);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    sigset_t all_signals, oldset;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &oldset);
+    pthread_t reader;
+    int err = pthread_create(&reader, &attr, read_input, NULL);
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        fprintf(stderr, "Can't start the thread reading the input: %s\n", strerror(err));
+        exit(1);
+    }
+}
+
+int arrival_queue_stream(void) {
+    num_process = workload_count();
+    pending = (Pending *) malloc(ARRIVAL_WINDOW * sizeof(Pending));
+    if (num_process == 0) {
+        workload_close();
+    }
+    return num_process;
+}
+
+void arrival_queue_start(bool in_background) {
+    if (num_process == 0) {
+        return;
+    }
+    if (in_background) {
+        start_reader();
+    } else {
+        read_ahead();
+    }
+}
+
+int arrival_input_fd(void) {
+    return input_pipe[0];
+}
+
+void arrival_queue_poll(void) {
+    char bytes[64];
+    while (read(input_pipe[0], bytes, sizeof(bytes)) > 0) {
+        continue;
+    }
+    read_ahead();
+}
+
+bool arrival_queue_ready(void) {
+    return processes != NULL || pending_count == ARRIVAL_WINDOW || read_count == num_process;
+}
+
+bool arrival_queue_empty(void) {
+    return arrived == num_process;
+}
+
+int arrivals_left(void) {
+    return num_process - arrived;
+}
+
+/* The process that arrives i-th, without --stream */
+static ProcessInfo *arrival(int i) {
+    return &processes[arrival_order != NULL ? arrival_order[i] : (uint32_t) i];
+}
+
+ProcessInfo *next_arrival(void) {
+    assert(!arrival_queue_empty() && arrival_queue_ready());
+    return processes != NULL ? arrival(arrived) : pending[0].process;
+}
+
+int timeunits_until_next_arrival(void) {
+    return next_arrival()->arrival_time - previous_arrival_time;
+}
+
+ProcessInfo *get_arrived_process(void) {
+    ProcessInfo *p = processes != NULL ? arrival(arrived) : pending_pop();
+    assert(arrived == 0 || p->arrival_time >= previous_arrival_time);
+    arrived++;
+    previous_arrival_time = p->arrival_time;
+    if (processes == NULL) {
+        read_ahead();
+    }
+    return p;
+}
+
+void arrival_queue_report_late(void) {
+    if (late_count > 1) {
+        fprintf(stderr, "%d processes arrived late in all\n", late_count);
+    }
+}
+
+void release_process(ProcessInfo *p) {
+    if (processes == NULL) {
+        workload_release(p);
+        free(p);
+    }
+}
@@ -0,0 +1,200 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "scheduler.h"
+
+/* Throughput of the arrival queue of arrivals.c on inputs that aren't sorted by arrival time.
+ *
+ * Without --stream, arrival_queue_init() sorts the processes. It is timed on n processes
+ * already in order, in order but for one in a hundred swapped with a neighbour, and shuffled,
+ * against qsort() of pointers to them by arrival time, as processinfo_ptr_cmp of main.c would
+ * have done. With --stream, the queue reads a text input of n processes, in order and shuffled
+ * within blocks of half of its window, until every process has arrived. Every run is checked
+ * to give the processes in order of arrival time, and arrival_queue_init() to keep those
+ * arriving together in input order.
+ * Each run is in a child of its own, since the queue is only set up once.
+ *
+ * Usage: ./bench_arrivals [PROCESSES]   (1000000 by default)
+ */
+
+#define BENCH_DEFAULT_PROCESSES 1000000
+#define BENCH_STREAM_BLOCK 512 // Half of ARRIVAL_WINDOW
+#define BILLION 1000000000L
+
+ScheduleStrategy current_strategy = FIFO;
+
+typedef enum Order {IN_ORDER, NEARLY_IN_ORDER, SHUFFLED} Order;
+static const char *order_names[] = {"in order", "nearly", "shuffled"};
+
+static unsigned long random_state = 1;
+
+static unsigned long next_random(void) {
+    random_state = random_state * 6364136223846793005UL + 1442695040888963407UL;
+    return random_state >> 33;
+}
+
+static double now_sec(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (double) now.tv_nsec / BILLION;
+}
+
+/* Arrival times i * 3 in the given order. time_needed holds the input position, to check
+ * that ties keep it; every third process ties with the one before. */
+static ProcessInfo *make_processes(int n, Order order) {
+    ProcessInfo *processes = (ProcessInfo *) calloc(n, sizeof(ProcessInfo));
+    for (int i = 0; i < n; i++) {
+        processes[i].arrival_time = i % 3 == 2 ? processes[i - 1].arrival_time : i * 3;
+    }
+    for (int i = 0; i + 1 < n; i++) {
+        if (order == SHUFFLED || (order == NEARLY_IN_ORDER && next_random() % 100 == 0)) {
+            int j = order == SHUFFLED ? i + (int) (next_random() % (n - i)) : i + 1;
+            int temp = processes[i].arrival_time;
+            processes[i].arrival_time = processes[j].arrival_time;
+            processes[j].arrival_time = temp;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        processes[i].time_needed = i;
+    }
+    return processes;
+}
+
+static bool before(const ProcessInfo *lhs, const ProcessInfo *rhs) {
+    return lhs->arrival_time < rhs->arrival_time
+            || (lhs->arrival_time == rhs->arrival_time && lhs->time_needed < rhs->time_needed);
+}
+
+static int processinfo_ptr_cmp(const void *lhs, const void *rhs) {
+    const ProcessInfo * const *lhs_p = lhs;
+    const ProcessInfo * const *rhs_p = rhs;
+    return (**lhs_p).arrival_time - (**rhs_p).arrival_time;
+}
+
+static double run_qsort(int n, Order order) {
+    ProcessInfo *processes = make_processes(n, order);
+    double begin = now_sec();
+    ProcessInfo **pointers = (ProcessInfo **) malloc(n * sizeof(ProcessInfo *));
+    for (int i = 0; i < n; i++) {
+        pointers[i] = &processes[i];
+    }
+    qsort(pointers, n, sizeof(ProcessInfo *), processinfo_ptr_cmp);
+    double seconds = now_sec() - begin;
+    for (int i = 1; i < n; i++) {
+        assert(pointers[i - 1]->arrival_time <= pointers[i]->arrival_time); // qsort() isn't stable.
+    }
+    return seconds;
+}
+
+static double run_queue(int n, Order order) {
+    ProcessInfo *processes = make_processes(n, order);
+    double begin = now_sec();
+    arrival_queue_init(processes, n);
+    ProcessInfo *previous = NULL;
+    while (!arrival_queue_empty()) {
+        ProcessInfo *p = get_arrived_process();
+        assert(previous == NULL || before(previous, p));
+        previous = p;
+    }
+    return now_sec() - begin;
+}
+
+/* Writes n processes arriving as make_processes() gives them, but shuffled only within blocks,
+ * so that all of them arrive in order with --stream. */
+static void write_input(const char *path, int n, Order order) {
+    FILE *fp = fopen(path, "w");
+    fprintf(fp, "FIFO\n%d\n", n);
+    ProcessInfo *processes = make_processes(n, IN_ORDER);
+    for (int block = 0; order == SHUFFLED && block < n; block += BENCH_STREAM_BLOCK) {
+        int size = n - block < BENCH_STREAM_BLOCK ? n - block : BENCH_STREAM_BLOCK;
+        for (int i = 0; i + 1 < size; i++) {
+            int j = i + (int) (next_random() % (size - i));
+            ProcessInfo temp = processes[block + i];
+            processes[block + i] = processes[block + j];
+            processes[block + j] = temp;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        fprintf(fp, "P%d %d %d\n", processes[i].time_needed, processes[i].arrival_time,
+                processes[i].time_needed + 1);
+    }
+    fclose(fp);
+    free(processes);
+}
+
+static double run_stream(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1 || dup2(fd, STDIN_FILENO) == -1) {
+        perror(path);
+        exit(1);
+    }
+    double begin = now_sec();
+    workload_open(true);
+    workload_policy();
+    arrival_queue_stream();
+    arrival_queue_start(false);
+    int previous_arrival = -1;
+    while (!arrival_queue_empty()) {
+        ProcessInfo *p = get_arrived_process();
+        assert(p->arrival_time >= previous_arrival);
+        previous_arrival = p->arrival_time;
+        release_process(p);
+    }
+    return now_sec() - begin;
+}
+
+/* Runs run(n, order) in a child and returns the seconds it measured. */
+static double in_child(double (*run)(int, Order), int n, Order order, const char *path) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        perror("pipe");
+        exit(1);
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        double seconds = path != NULL ? run_stream(path) : run(n, order);
+        write(fds[1], &seconds, sizeof(seconds));
+        exit(0);
+    }
+    close(fds[1]);
+    double seconds;
+    assert(read(fds[0], &seconds, sizeof(seconds)) == sizeof(seconds));
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    return seconds;
+}
+
+static void print_row(const char *what, const char *order, int n, double seconds) {
+    printf("%-20s %-10s %10.3f %16.1f\n", what, order, seconds, n / seconds / 1e6);
+}
+
+int main(int argc, char *argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_PROCESSES;
+    printf("%d processes\n%-20s %-10s %10s %16s\n", n, "", "order", "seconds", "Mprocesses/s");
+    for (Order order = IN_ORDER; order <= SHUFFLED; order++) {
+        print_row("qsort of pointers", order_names[order], n, in_child(run_qsort, n, order, NULL));
+        print_row("arrival_queue_init", order_names[order], n, in_child(run_queue, n, order, NULL));
+    }
+    char path[] = "/tmp/bench_arrivals_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        perror("mkstemp");
+        exit(1);
+    }
+    close(fd);
+    for (Order order = IN_ORDER; order <= SHUFFLED; order += SHUFFLED - IN_ORDER) {
+        write_input(path, n, order);
+        print_row("--stream", order == SHUFFLED ? "in blocks" : order_names[order], n,
+                in_child(NULL, n, order, path));
+    }
+    unlink(path);
+    return 0;
+}
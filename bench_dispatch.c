@@ -0,0 +1,220 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "scheduler.h"
+
+/* Cost of dispatching an event to the scheduler through its SchedulerOps, against the switch on
+ * current_strategy that main.c used before. The policies only export their tables, so the switch
+ * calls the functions through the table each case names: what is compared is the switch against
+ * loading the table from scheduler_ops.
+ *
+ * For every policy, n processes are queued, then every round ends a time slice (for the
+ * policies that have them), switches, asks for the queue length, terminates the running
+ * process and admits a new one, as the event loop would. The same rounds are dispatched both
+ * ways, and the order the processes ran in is checked to be the same. The last column is
+ * the dispatch alone: queue_length(), the cheapest scheduler function, called in a loop.
+ *
+ * Usage: ./bench_dispatch
+ */
+
+#define BENCH_PROCESSES 1000
+#define BENCH_ROUNDS 200000
+#define BENCH_CALLS 20000000
+#define BILLION 1000000000L
+
+// The policies are linked on their own. In simulation mode, their context switches only record the process resumed.
+bool simulation_mode = true;
+int num_cpus = 1;
+int current_cpu = 0;
+ScheduleStrategy current_strategy;
+static const SchedulerOps *ops;
+static pid_t last_resumed;
+void sim_suspend_process(pid_t pid) { (void) pid; }
+void sim_resume_process(pid_t pid) { last_resumed = pid; }
+void switch_suspend(pid_t pid) { (void) pid; }
+void switch_resume(pid_t pid) { (void) pid; }
+
+/* The dispatch that main.c used before, for the events of a round. */
+static void switch_add_process(ProcessInfo *p) {
+    switch (current_strategy) {
+        case FIFO: FIFO_ops.add_process(p); break;
+        case RR: RR_ops.add_process(p); break;
+        case SJF: SJF_ops.add_process(p); break;
+        case PSJF: PSJF_ops.add_process(p); break;
+        case MLFQ: MLFQ_ops.add_process(p); break;
+        case EDF: EDF_ops.add_process(p); break;
+        case CFS: CFS_ops.add_process(p); break;
+        case STRIDE: STRIDE_ops.add_process(p); break;
+        case LOTTERY: LOTTERY_ops.add_process(p); break;
+        case HRRN: HRRN_ops.add_process(p); break;
+        default: assert(0);
+    }
+}
+
+static void switch_remove_current_process(void) {
+    switch (current_strategy) {
+        case FIFO: FIFO_ops.remove_current_process(); break;
+        case RR: RR_ops.remove_current_process(); break;
+        case SJF: SJF_ops.remove_current_process(); break;
+        case PSJF: PSJF_ops.remove_current_process(); break;
+        case MLFQ: MLFQ_ops.remove_current_process(); break;
+        case EDF: EDF_ops.remove_current_process(); break;
+        case CFS: CFS_ops.remove_current_process(); break;
+        case STRIDE: STRIDE_ops.remove_current_process(); break;
+        case LOTTERY: LOTTERY_ops.remove_current_process(); break;
+        case HRRN: HRRN_ops.remove_current_process(); break;
+        default: assert(0);
+    }
+}
+
+static void switch_timeslice_over(long now) {
+    switch (current_strategy) {
+        case RR: RR_ops.timeslice_over(now); break;
+        case MLFQ: MLFQ_ops.timeslice_over(now); break;
+        case CFS: CFS_ops.timeslice_over(now); break;
+        case STRIDE: STRIDE_ops.timeslice_over(now); break;
+        case LOTTERY: LOTTERY_ops.timeslice_over(now); break;
+        default: assert(0);
+    }
+}
+
+static void switch_context_switch(void) {
+    switch (current_strategy) {
+        case FIFO: FIFO_ops.context_switch(); break;
+        case RR: RR_ops.context_switch(); break;
+        case SJF: SJF_ops.context_switch(); break;
+        case PSJF: PSJF_ops.context_switch(); break;
+        case MLFQ: MLFQ_ops.context_switch(); break;
+        case EDF: EDF_ops.context_switch(); break;
+        case CFS: CFS_ops.context_switch(); break;
+        case STRIDE: STRIDE_ops.context_switch(); break;
+        case LOTTERY: LOTTERY_ops.context_switch(); break;
+        case HRRN: HRRN_ops.context_switch(); break;
+        default: assert(0);
+    }
+}
+
+static int switch_queue_length(void) {
+    switch (current_strategy) {
+        case FIFO: return FIFO_ops.queue_length();
+        case RR: return RR_ops.queue_length();
+        case SJF: return SJF_ops.queue_length();
+        case PSJF: return PSJF_ops.queue_length();
+        case MLFQ: return MLFQ_ops.queue_length();
+        case EDF: return EDF_ops.queue_length();
+        case CFS: return CFS_ops.queue_length();
+        case STRIDE: return STRIDE_ops.queue_length();
+        case LOTTERY: return LOTTERY_ops.queue_length();
+        case HRRN: return HRRN_ops.queue_length();
+        default: assert(0);
+    }
+    return 0;
+}
+
+/* The dispatch through SchedulerOps, as in main.c now. */
+static void ops_add_process(ProcessInfo *p) { ops->add_process(p); }
+static void ops_remove_current_process(void) { ops->remove_current_process(); }
+static void ops_timeslice_over(long now) { ops->timeslice_over(now); }
+static void ops_context_switch(void) { ops->context_switch(); }
+static int ops_queue_length(void) { return ops->queue_length(); }
+
+typedef struct Dispatch {
+    void (*add_process)(ProcessInfo *);
+    void (*remove_current_process)(void);
+    void (*timeslice_over)(long now);
+    void (*context_switch)(void);
+    int (*queue_length)(void);
+} Dispatch;
+
+static const Dispatch switch_dispatch = {
+    switch_add_process, switch_remove_current_process, switch_timeslice_over, switch_context_switch,
+    switch_queue_length,
+};
+static const Dispatch ops_dispatch = {
+    ops_add_process, ops_remove_current_process, ops_timeslice_over, ops_context_switch, ops_queue_length,
+};
+
+static double now_sec(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (double) now.tv_nsec / BILLION;
+}
+
+/* The processes as read_single_entry() leaves them, with times in a fixed pseudo-random order. */
+static ProcessInfo *make_processes(int n) {
+    ProcessInfo *processes = (ProcessInfo *) calloc(n, sizeof(ProcessInfo));
+    for (int i = 0; i < n; i++) {
+        ProcessInfo *p = &processes[i];
+        p->pid = i + 1;
+        p->time_needed = p->remaining_time = 1 + (i * 7919) % 5000;
+        p->arrival_time = p->wait_origin = 0;
+        p->cpu = 0;
+        p->heap_index = p->heap_bucket = p->queue_slot = -1;
+        p->deadline = p->edf_deadline = NO_DEADLINE;
+        p->weight = current_strategy == CFS ? CFS_DEFAULT_WEIGHT : DEFAULT_TICKETS;
+    }
+    return processes;
+}
+
+/* Returns the order in which the processes ran, as a checksum of their pids.
+ * Inlined, so that the calls through d are direct calls to the dispatch measured. */
+static inline __attribute__((always_inline)) unsigned long run_rounds(const Dispatch *d, double *seconds) {
+    unsigned long order = 0;
+    ProcessInfo *processes = make_processes(BENCH_PROCESSES + BENCH_ROUNDS);
+    ops->set_strategy(BENCH_PROCESSES + BENCH_ROUNDS);
+    for (int i = 0; i < BENCH_PROCESSES; i++) {
+        d->add_process(&processes[i]);
+    }
+    d->context_switch();
+    long length = 0;
+    double begin = now_sec();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        if (ops->timeslice_over != NULL) {
+            d->timeslice_over((long) (round + 1) * ops->timeslice_length());
+            d->context_switch();
+        }
+        length += d->queue_length();
+        d->remove_current_process();
+        d->add_process(&processes[BENCH_PROCESSES + round]);
+        d->context_switch();
+        order = order * 31 + last_resumed;
+    }
+    *seconds = now_sec() - begin;
+    assert(length == (long) BENCH_PROCESSES * BENCH_ROUNDS);
+    // The queues keep pointers to the processes, so they are not freed.
+    return order;
+}
+
+static inline __attribute__((always_inline)) double time_queue_length(const Dispatch *d) {
+    long length = 0;
+    double begin = now_sec();
+    for (int i = 0; i < BENCH_CALLS; i++) {
+        length += d->queue_length();
+    }
+    double seconds = now_sec() - begin;
+    assert(length == (long) BENCH_PROCESSES * BENCH_CALLS);
+    return seconds;
+}
+
+int main(void) {
+    static const SchedulerOps *const policies[] = {
+        [FIFO] = &FIFO_ops, [RR] = &RR_ops, [SJF] = &SJF_ops, [PSJF] = &PSJF_ops, [MLFQ] = &MLFQ_ops,
+        [EDF] = &EDF_ops, [CFS] = &CFS_ops, [STRIDE] = &STRIDE_ops, [LOTTERY] = &LOTTERY_ops, [HRRN] = &HRRN_ops,
+    };
+    printf("%-8s %16s %16s %14s %14s\n", "policy", "switch ns/round", "ops ns/round", "switch ns/call", "ops ns/call");
+    for (int s = 0; s < PLUGIN; s++) {
+        current_strategy = s;
+        ops = policies[s];
+        double switch_sec, ops_sec;
+        unsigned long switch_order = run_rounds(&switch_dispatch, &switch_sec);
+        unsigned long ops_order = run_rounds(&ops_dispatch, &ops_sec);
+        assert(switch_order == ops_order);
+        double switch_call_sec = time_queue_length(&switch_dispatch);
+        double ops_call_sec = time_queue_length(&ops_dispatch);
+        printf("%-8s %16.1f %16.1f %14.2f %14.2f\n", ops->name,
+                switch_sec * BILLION / BENCH_ROUNDS, ops_sec * BILLION / BENCH_ROUNDS,
+                switch_call_sec * BILLION / BENCH_CALLS, ops_call_sec * BILLION / BENCH_CALLS);
+    }
+    return 0;
+}
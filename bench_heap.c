@@ -0,0 +1,302 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "scheduler.h"
+
+/* Cost of the SJF/PSJF heap per process, against the binary heap of pointers it replaced.
+ *
+ * The heap of heap.c is measured with and without its radix part, on two workloads:
+ * - n processes with random remaining times are inserted, then popped until the heap is empty;
+ * - the SJF and PSJF tests in OS_PJ1_Test, copied over and over with the arrivals shifted so
+ *   that jobs arrive twice as fast as they can run, replayed the way the scheduler uses the heap.
+ * Every heap is fed the same processes, and the order they finish in is checked to be the same.
+ *
+ * Usage: ./bench_heap   (from the directory holding OS_PJ1_Test)
+ */
+
+#define BILLION 1000000000L
+#define MAX_REMAINING_TIME 100000
+#define OVERLOAD 2 // Work arriving per unit of time
+#define TEST_FILES 5
+
+/* The binary heap that heap.c used before: pointers, compared through ProcessInfo. */
+static ProcessInfo **pq;
+static int pq_size;
+
+static bool pointer_lt(int lhsIdx, int rhsIdx) {
+    const ProcessInfo *lhs = pq[lhsIdx];
+    const ProcessInfo *rhs = pq[rhsIdx];
+    if (lhs->remaining_time == rhs->remaining_time) {
+        return lhs->pid < rhs->pid;
+    }
+    return lhs->remaining_time < rhs->remaining_time;
+}
+
+static void pointer_swap(int lhs, int rhs) {
+    ProcessInfo *temp = pq[lhs];
+    pq[lhs] = pq[rhs];
+    pq[rhs] = temp;
+}
+
+static void pointer_init(int n) {
+    free(pq);
+    pq = (ProcessInfo **) malloc(sizeof(ProcessInfo *) * n);
+    pq_size = 0;
+}
+
+static void pointer_insert(ProcessInfo *p) {
+    int childIdx = pq_size++;
+    pq[childIdx] = p;
+    while (childIdx > 0 && pointer_lt(childIdx, (childIdx - 1) / 2)) {
+        pointer_swap((childIdx - 1) / 2, childIdx);
+        childIdx = (childIdx - 1) / 2;
+    }
+}
+
+static ProcessInfo *pointer_top(void) {
+    return pq[0];
+}
+
+static void pointer_pop(void) {
+    pointer_swap(--pq_size, 0);
+    int parentIdx = 0;
+    while (parentIdx * 2 + 1 < pq_size) {
+        int minIdx = parentIdx;
+        if (pointer_lt(parentIdx * 2 + 1, minIdx)) {
+            minIdx = parentIdx * 2 + 1;
+        }
+        if (parentIdx * 2 + 2 < pq_size && pointer_lt(parentIdx * 2 + 2, minIdx)) {
+            minIdx = parentIdx * 2 + 2;
+        }
+        if (parentIdx == minIdx) {
+            break;
+        }
+        pointer_swap(parentIdx, minIdx);
+        parentIdx = minIdx;
+    }
+}
+
+// PSJF only shortens the job on top, which stays there.
+static void pointer_update(ProcessInfo *p) {
+    assert(pq[0] == p);
+}
+
+static bool pointer_empty(void) {
+    return pq_size == 0;
+}
+
+/* The heap of heap.c */
+static Heap heap;
+static bool heap_allocated = false;
+static bool use_radix;
+
+static void inline_init(int n) {
+    (void) n;
+    if (heap_allocated) {
+        heap_free(&heap);
+    }
+    heap_init_radix(&heap, use_radix);
+    heap_allocated = true;
+}
+
+static void inline_insert(ProcessInfo *p) {
+    heap_insert(&heap, p);
+}
+
+static ProcessInfo *inline_top(void) {
+    return heap_top(&heap);
+}
+
+static void inline_pop(void) {
+    heap_pop(&heap);
+}
+
+static void inline_update(ProcessInfo *p) {
+    heap_update(&heap, p);
+}
+
+static bool inline_empty(void) {
+    return heap_empty(&heap);
+}
+
+typedef struct HeapOps {
+    const char *name;
+    bool radix;
+    void (*init)(int n);
+    void (*insert)(ProcessInfo *);
+    ProcessInfo *(*top)(void);
+    void (*pop)(void);
+    void (*update)(ProcessInfo *);
+    bool (*empty)(void);
+} HeapOps;
+
+static const HeapOps heaps[] = {
+    {"4-ary", false, inline_init, inline_insert, inline_top, inline_pop, inline_update, inline_empty},
+    {"radix", true, inline_init, inline_insert, inline_top, inline_pop, inline_update, inline_empty},
+    {"binary", false, pointer_init, pointer_insert, pointer_top, pointer_pop, pointer_update, pointer_empty},
+};
+#define NUM_HEAPS (int) (sizeof(heaps) / sizeof(heaps[0]))
+
+typedef unsigned long (*Workload)(const HeapOps *, ProcessInfo *, int);
+
+/* Each workload returns the order in which the processes finished, as a checksum of their pids. */
+static unsigned long insert_pop_all(const HeapOps *ops, ProcessInfo *processes, int n) {
+    unsigned long order = 0;
+    for (int i = 0; i < n; i++) {
+        ops->insert(&processes[i]);
+    }
+    while (!ops->empty()) {
+        order = order * 31 + ops->top()->pid;
+        ops->pop();
+    }
+    return order;
+}
+
+/* A job runs until it finishes; the shortest one waiting runs next. */
+static unsigned long replay_SJF(const HeapOps *ops, ProcessInfo *processes, int n) {
+    unsigned long order = 0;
+    long now = 0;
+    int next = 0;
+    for (int done = 0; done < n; done++) {
+        if (ops->empty() && processes[next].arrival_time > now) {
+            now = processes[next].arrival_time;
+        }
+        for (; next < n && processes[next].arrival_time <= now; next++) {
+            ops->insert(&processes[next]);
+        }
+        ProcessInfo *running = ops->top();
+        ops->pop();
+        now += running->remaining_time;
+        order = order * 31 + running->pid;
+    }
+    return order;
+}
+
+/* The running job stays on top, and is charged the time it ran whenever a job arrives. */
+static unsigned long replay_PSJF(const HeapOps *ops, ProcessInfo *processes, int n) {
+    unsigned long order = 0;
+    long now = 0;
+    int next = 0;
+    while (next < n || !ops->empty()) {
+        if (ops->empty() && processes[next].arrival_time > now) {
+            now = processes[next].arrival_time;
+        }
+        for (; next < n && processes[next].arrival_time <= now; next++) {
+            ops->insert(&processes[next]);
+        }
+        ProcessInfo *running = ops->top();
+        if (next == n || now + running->remaining_time <= processes[next].arrival_time) {
+            now += running->remaining_time;
+            ops->pop();
+            order = order * 31 + running->pid;
+        } else {
+            running->remaining_time -= processes[next].arrival_time - now;
+            ops->update(running);
+            now = processes[next].arrival_time;
+        }
+    }
+    return order;
+}
+
+static double now_sec(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (double) now.tv_nsec / BILLION;
+}
+
+static void run_all(const char *label, Workload workload, ProcessInfo *processes, int n) {
+    unsigned long first_order = 0;
+    printf("%-5s %9d", label, n);
+    for (int i = 0; i < NUM_HEAPS; i++) {
+        for (int j = 0; j < n; j++) {
+            processes[j].remaining_time = processes[j].time_needed;
+        }
+        use_radix = heaps[i].radix;
+        heaps[i].init(n);
+        double begin = now_sec();
+        unsigned long order = workload(&heaps[i], processes, n);
+        double seconds = now_sec() - begin;
+        if (i == 0) {
+            first_order = order;
+        }
+        assert(order == first_order);
+        printf(" %14.1f", seconds * BILLION / n);
+    }
+    printf("\n");
+}
+
+/* The jobs of OS_PJ1_Test/<policy>_1.txt .. _5.txt, copied until there are n of them.
+ * A new copy starts arriving after 1 / OVERLOAD of the work in the previous one. */
+static ProcessInfo *scaled_tests(const char *policy, int n) {
+    ProcessInfo tests[TEST_FILES * 16];
+    int count = 0, work = 0;
+    for (int f = 1; f <= TEST_FILES; f++) {
+        char path[64], name[32];
+        snprintf(path, sizeof(path), "OS_PJ1_Test/%s_%d.txt", policy, f);
+        FILE *fp = fopen(path, "r");
+        int jobs;
+        if (fp == NULL || fscanf(fp, "%31s %d", name, &jobs) != 2) {
+            perror(path);
+            exit(1);
+        }
+        for (int j = 0; j < jobs && count < (int) (sizeof(tests) / sizeof(tests[0])); j++, count++) {
+            if (fscanf(fp, "%31s %d %d", name, &tests[count].arrival_time, &tests[count].time_needed) != 3) {
+                fprintf(stderr, "%s: bad line\n", path);
+                exit(1);
+            }
+            work += tests[count].time_needed;
+        }
+        fclose(fp);
+    }
+
+    ProcessInfo *processes = (ProcessInfo *) calloc(n, sizeof(ProcessInfo));
+    for (int i = 0; i < n; i++) {
+        const ProcessInfo *test = &tests[i % count];
+        processes[i].arrival_time = test->arrival_time + (i / count) * (work / OVERLOAD);
+        processes[i].time_needed = test->time_needed;
+        processes[i].pid = i + 1;
+    }
+    // Jobs of one copy arrive in file order, not in time order.
+    for (int i = 1; i < n; i++) {
+        ProcessInfo p = processes[i];
+        int j = i;
+        for (; j > 0 && processes[j - 1].arrival_time > p.arrival_time; j--) {
+            processes[j] = processes[j - 1];
+        }
+        processes[j] = p;
+    }
+    return processes;
+}
+
+int main(void) {
+    srand(1);
+    printf("%-5s %9s", "", "processes");
+    for (int i = 0; i < NUM_HEAPS; i++) {
+        char column[32];
+        snprintf(column, sizeof(column), "%s ns/op", heaps[i].name);
+        printf(" %14s", column);
+    }
+    printf("\n");
+
+    for (int n = 1000; n <= 10000000; n *= 10) {
+        ProcessInfo *processes = (ProcessInfo *) calloc(n, sizeof(ProcessInfo));
+        for (int i = 0; i < n; i++) {
+            processes[i].pid = i + 1;
+            processes[i].time_needed = rand() % MAX_REMAINING_TIME;
+        }
+        run_all("all", insert_pop_all, processes, n);
+        free(processes);
+    }
+    const char *policies[] = {"SJF", "PSJF"};
+    const Workload replays[] = {replay_SJF, replay_PSJF};
+    for (int p = 0; p < 2; p++) {
+        for (int n = 1000; n <= 1000000; n *= 10) {
+            ProcessInfo *processes = scaled_tests(policies[p], n);
+            run_all(policies[p], replays[p], processes, n);
+            free(processes);
+        }
+    }
+    return 0;
+}
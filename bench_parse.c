@@ -0,0 +1,200 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "scheduler.h"
+
+/* Time and peak memory to read a workload, with workload.c against the scanf() loader it replaced.
+ *
+ * A workload of n processes named P1, P2, ... is written to a file, and converted to the binary
+ * format of workload.c. Then each loader reads it from stdin in a child of its own, so that its
+ * peak RSS is its own: scanf() and workload.c the text, and workload.c the binary. All are
+ * checked to read the same processes.
+ *
+ * Usage: ./bench_parse [PROCESSES]   (1000000 by default)
+ */
+
+#define BENCH_DEFAULT_PROCESSES 1000000
+#define PROCESS_NAME_MAX 100
+#define BILLION 1000000000L
+
+ScheduleStrategy current_strategy = FIFO;
+
+/* The loader that main.c used before */
+static void scanf_read_single_entry(ProcessInfo *p) {
+    char *process_name = (char *)malloc(sizeof(char) * PROCESS_NAME_MAX);
+    scanf("%s", process_name);
+    p->name = process_name;
+    scanf("%d%d", &p->arrival_time, &p->time_needed);
+    p->remaining_time = p->time_needed;
+    p->status = NOT_STARTED;
+    p->pid = 0;
+    p->start_time = p->finish_time = -1;
+    p->cpu = -1;
+    p->heap_index = -1;
+    p->heap_bucket = -1;
+    p->mlfq_level = p->mlfq_slices = 0;
+    p->admission = NOT_ADMITTED;
+    p->edf_node = NULL;
+    p->deadline = p->edf_deadline = NO_DEADLINE;
+    p->weight = current_strategy == CFS ? CFS_DEFAULT_WEIGHT : DEFAULT_TICKETS;
+    p->vruntime = 0;
+    p->queue_slot = -1;
+    p->wait_origin = p->arrival_time;
+    p->prediction_error = 0;
+    int c;
+    while ((c = getchar()) == ' ' || c == '\t') {}
+    if (c != EOF) {
+        ungetc(c, stdin);
+    }
+    if (c == '\n' || c == '\r' || c == EOF) {
+        return;
+    }
+    if (scanf("%d", &p->deadline) != 1) {
+        fprintf(stderr, "%s: the deadline must be a number of time units\n", p->name);
+        exit(1);
+    }
+}
+
+static ProcessInfo *scanf_read(int *num_process) {
+    char strat[PROCESS_NAME_MAX];
+    scanf("%s", strat);
+    scanf("%d", num_process);
+    ProcessInfo *processes = (ProcessInfo *) malloc(*num_process * sizeof(ProcessInfo));
+    for (int i = 0; i < *num_process; i++) {
+        scanf_read_single_entry(&processes[i]);
+    }
+    return processes;
+}
+
+static ProcessInfo *workload_read(int *num_process) {
+    workload_open(false);
+    workload_policy();
+    ProcessInfo *processes = workload_processes(num_process);
+    workload_close();
+    return processes;
+}
+
+/* Writes the workload at text_path to binary_path, in a child so that it doesn't grow our RSS. */
+static void convert_to_binary(const char *text_path, const char *binary_path) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int in = open(text_path, O_RDONLY);
+        int out = open(binary_path, O_WRONLY | O_TRUNC);
+        if (in == -1 || out == -1 || dup2(in, STDIN_FILENO) == -1 || dup2(out, STDOUT_FILENO) == -1) {
+            perror("Can't convert the workload");
+            exit(1);
+        }
+        int n;
+        workload_open(false);
+        char *policy = workload_policy();
+        ProcessInfo *processes = workload_processes(&n);
+        workload_close();
+        workload_write(stdout, policy, processes, n, BINARY_WORKLOAD);
+        exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+static long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
+static double now_sec(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (double) now.tv_nsec / BILLION;
+}
+
+typedef struct Result {
+    double seconds;
+    unsigned long checksum; // Of what was read
+} Result;
+
+/* Reads path in a child with loader, and returns its time, its checksum and its peak RSS in KiB. */
+static Result run_loader(ProcessInfo *(*loader)(int *), const char *path, long *max_rss_kb) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        perror("pipe");
+        exit(1);
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        int fd = open(path, O_RDONLY);
+        if (fd == -1 || dup2(fd, STDIN_FILENO) == -1) {
+            perror(path);
+            exit(1);
+        }
+        Result result = {0, 0};
+        int n;
+        double begin = now_sec();
+        ProcessInfo *processes = loader(&n);
+        result.seconds = now_sec() - begin;
+        for (int i = 0; i < n; i++) {
+            result.checksum = result.checksum * 31 + processes[i].arrival_time * 7 + processes[i].time_needed
+                    + strlen(processes[i].name);
+        }
+        write(fds[1], &result, sizeof(result));
+        exit(0);
+    }
+    close(fds[1]);
+    Result result;
+    assert(read(fds[0], &result, sizeof(result)) == sizeof(result));
+    close(fds[0]);
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    *max_rss_kb = usage.ru_maxrss;
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_PROCESSES;
+    char path[] = "/tmp/bench_parse_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        perror("mkstemp");
+        exit(1);
+    }
+    FILE *fp = fdopen(fd, "w");
+    fprintf(fp, "FIFO\n%d\n", n);
+    unsigned long random_state = 1;
+    for (int i = 0; i < n; i++) {
+        random_state = random_state * 6364136223846793005UL + 1442695040888963407UL;
+        fprintf(fp, "P%d %d %lu\n", i + 1, i * 3, (random_state >> 33) % 10000 + 1);
+    }
+    fclose(fp);
+    char binary_path[] = "/tmp/bench_parse_XXXXXX";
+    int binary_fd = mkstemp(binary_path);
+    if (binary_fd == -1) {
+        perror("mkstemp");
+        exit(1);
+    }
+    close(binary_fd);
+    convert_to_binary(path, binary_path);
+
+    long scanf_rss, text_rss, binary_rss;
+    Result scanf_result = run_loader(scanf_read, path, &scanf_rss);
+    Result text_result = run_loader(workload_read, path, &text_rss);
+    Result binary_result = run_loader(workload_read, binary_path, &binary_rss);
+    printf("%d processes, %.1f MiB of text, %.1f MiB of binary\n", n,
+            file_size(path) / 1048576.0, file_size(binary_path) / 1048576.0);
+    unlink(path);
+    unlink(binary_path);
+    assert(scanf_result.checksum == text_result.checksum && text_result.checksum == binary_result.checksum);
+    printf("%-10s %10s %14s\n", "loader", "seconds", "peak RSS MiB");
+    printf("%-10s %10.3f %14.1f\n", "scanf", scanf_result.seconds, scanf_rss / 1024.0);
+    printf("%-10s %10.3f %14.1f\n", "text", text_result.seconds, text_rss / 1024.0);
+    printf("%-10s %10.3f %14.1f\n", "binary", binary_result.seconds, binary_rss / 1024.0);
+    return 0;
+}
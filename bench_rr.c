@@ -0,0 +1,128 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "scheduler.h"
+
+/* Cost of the RR run queue per event, against the array it replaced, as the number of live processes grows.
+ *
+ * With n processes queued, every round ends a time slice, then the current process
+ * terminates and a new one arrives. Both queues are fed the same events, and the
+ * process each one would run is checked to be the same.
+ *
+ * Usage: ./bench_rr
+ */
+
+#define BENCH_ROUNDS 20000
+#define BILLION 1000000000L
+
+// RR.c is linked on its own. In simulation mode, its context switches only record the process resumed.
+bool simulation_mode = true;
+int num_cpus = 1;
+int current_cpu = 0;
+static pid_t last_resumed;
+void sim_suspend_process(pid_t pid) { (void) pid; }
+void sim_resume_process(pid_t pid) { last_resumed = pid; }
+void switch_suspend(pid_t pid) { (void) pid; }
+void switch_resume(pid_t pid) { (void) pid; }
+
+/* The array run queue that RR.c used before, minus the context switches. */
+static ProcessInfo **pq;
+static int current_process_id = -1;
+static int process_count = 0;
+
+static void array_add(ProcessInfo *p) {
+    if (process_count == 0) {
+        current_process_id = 0;
+        pq[current_process_id] = p;
+    } else {
+        for (int i = process_count - 1; i >= current_process_id; i--) {
+            pq[i+1] = pq[i];
+        }
+        pq[current_process_id] = p;
+        current_process_id++;
+    }
+    process_count++;
+}
+
+static void array_remove_current(void) {
+    for (int i = current_process_id + 1; i < process_count; i++) {
+        pq[i-1] = pq[i];
+    }
+    process_count--;
+    if (process_count == 0) {
+        current_process_id = -1;
+    } else if (current_process_id == process_count) {
+        current_process_id = 0;
+    }
+}
+
+static void array_timeslice_over(void) {
+    current_process_id++;
+    if (current_process_id == process_count) {
+        current_process_id = 0;
+    }
+}
+
+static double now_sec(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (double) now.tv_nsec / BILLION;
+}
+
+/* Returns the order in which the processes ran, as a checksum of their pids. */
+static unsigned long run_linked(ProcessInfo *processes, int n, double *seconds) {
+    unsigned long order = 0;
+    RR_ops.set_strategy(n);
+    for (int i = 0; i < n; i++) {
+        RR_ops.add_process(&processes[i]);
+    }
+    double begin = now_sec();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        RR_ops.timeslice_over((long) (round + 1) * rr_quantum);
+        RR_ops.context_switch();
+        RR_ops.remove_current_process();
+        RR_ops.add_process(&processes[n + round]);
+        RR_ops.context_switch();
+        order = order * 31 + last_resumed;
+    }
+    *seconds = now_sec() - begin;
+    return order;
+}
+
+static unsigned long run_array(ProcessInfo *processes, int n, double *seconds) {
+    unsigned long order = 0;
+    pq = (ProcessInfo **) malloc(sizeof(ProcessInfo *) * n);
+    process_count = 0;
+    current_process_id = -1;
+    for (int i = 0; i < n; i++) {
+        array_add(&processes[i]);
+    }
+    double begin = now_sec();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        array_timeslice_over();
+        array_remove_current();
+        array_add(&processes[n + round]);
+        order = order * 31 + pq[current_process_id]->pid;
+    }
+    *seconds = now_sec() - begin;
+    free(pq);
+    return order;
+}
+
+int main(void) {
+    printf("%9s %14s %14s\n", "processes", "linked ns/op", "array ns/op");
+    for (int n = 1000; n <= 1000000; n *= 10) {
+        ProcessInfo *processes = (ProcessInfo *) calloc(n + BENCH_ROUNDS, sizeof(ProcessInfo));
+        for (int i = 0; i < n + BENCH_ROUNDS; i++) {
+            processes[i].pid = i + 1;
+        }
+        double linked_sec, array_sec;
+        unsigned long linked_order = run_linked(processes, n, &linked_sec);
+        unsigned long array_order = run_array(processes, n, &array_sec);
+        assert(linked_order == array_order);
+        printf("%9d %14.1f %14.1f\n", n, linked_sec * BILLION / BENCH_ROUNDS, array_sec * BILLION / BENCH_ROUNDS);
+        free(processes);
+    }
+    return 0;
+}
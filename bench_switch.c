@@ -0,0 +1,153 @@
+#define _GNU_SOURCE // sched_setaffinity()
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "scheduler.h"
+
+/* Context-switch latency of each backend in switch.c.
+ *
+ * Two children spin on the same CPU as the scheduler, one resumed and one suspended.
+ * In every round the scheduler suspends the running child, resumes the other one and
+ * sleeps, like the event loop does after a context switch. The latency is the time from
+ * the decision until the resumed child notices that it runs.
+ *
+ * Usage: ./bench_switch [prio] [signal] [cgroup]   (needs root for SCHED_FIFO and cgroups)
+ */
+
+#define BENCH_ROUNDS 2000
+#define BENCH_WARMUP 100
+#define BILLION 1000000000L
+
+typedef struct SharedState {
+    volatile int target; // The child that should run
+    volatile int64_t ran_ns; // Set by the target when it runs; 0 until then
+} SharedState;
+
+static pid_t children[2];
+static SharedState *shared;
+
+// switch.c reports errors through this.
+void scheduler_exit(int status) {
+    switch_release_all();
+    for (int i = 0; i < 2; i++) {
+        if (children[i] > 0) {
+            kill(children[i], SIGKILL);
+        }
+    }
+    exit(status);
+}
+
+static int64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * BILLION + now.tv_nsec;
+}
+
+static _Noreturn void spin(int me) {
+    while (true) {
+        if (shared->target == me && shared->ran_ns == 0) {
+            shared->ran_ns = now_ns();
+        }
+    }
+}
+
+static int int64_cmp(const void *lhs, const void *rhs) {
+    int64_t l = *(const int64_t *) lhs, r = *(const int64_t *) rhs;
+    return (l > r) - (l < r);
+}
+
+static void run_backend(SwitchBackend backend, const char *name) {
+    switch_init(backend);
+    shared->target = 0;
+    shared->ran_ns = 0;
+    for (int i = 0; i < 2; i++) {
+        children[i] = fork();
+        if (children[i] == 0) {
+            spin(i);
+        }
+        set_priority(children[i], sched_get_priority_max(SCHED_FIFO) - 1);
+        switch_attach(children[i]);
+        if (i == 1) {
+            switch_suspend(children[i]);
+        }
+    }
+
+    static int64_t latency[BENCH_ROUNDS];
+    int running = 0;
+    const struct timespec nap = {0, 100000};
+    for (int round = -BENCH_WARMUP; round < BENCH_ROUNDS; round++) {
+        int next = 1 - running;
+        shared->ran_ns = 0;
+        shared->target = next;
+        int64_t decision = now_ns();
+        switch_suspend(children[running]);
+        switch_resume(children[next]);
+        while (shared->ran_ns == 0) {
+            nanosleep(&nap, NULL);
+        }
+        if (round >= 0) {
+            latency[round] = shared->ran_ns - decision;
+        }
+        running = next;
+    }
+
+    switch_release_all();
+    for (int i = 0; i < 2; i++) {
+        kill(children[i], SIGKILL);
+        waitpid(children[i], NULL, 0);
+        switch_detach(children[i]);
+        children[i] = 0;
+    }
+    switch_shutdown();
+
+    qsort(latency, BENCH_ROUNDS, sizeof(int64_t), int64_cmp);
+    int64_t total = 0;
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        total += latency[i];
+    }
+    printf("%-7s mean %7ld ns  p50 %7ld ns  p99 %7ld ns  max %7ld ns\n", name, (long) (total / BENCH_ROUNDS),
+            (long) latency[BENCH_ROUNDS / 2], (long) latency[BENCH_ROUNDS * 99 / 100], (long) latency[BENCH_ROUNDS - 1]);
+}
+
+int main(int argc, char *argv[]) {
+    const char *names[] = {"prio", "signal", "cgroup"};
+    const SwitchBackend backends[] = {PRIORITY_SWITCH, SIGNAL_SWITCH, CGROUP_SWITCH};
+
+    // Everything on one CPU, so that a child only runs when the scheduler sleeps.
+    cpu_set_t one_cpu;
+    CPU_ZERO(&one_cpu);
+    CPU_SET(sched_getcpu(), &one_cpu);
+    struct sched_param param = {sched_get_priority_max(SCHED_FIFO)};
+    if (sched_setaffinity(0, sizeof(one_cpu), &one_cpu) == -1 || sched_setscheduler(0, SCHED_FIFO, &param) == -1) {
+        perror("bench_switch needs root");
+        return 1;
+    }
+    shared = mmap(NULL, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    for (int i = 1; i < argc; i++) {
+        int b;
+        for (b = 0; b < 3 && strcmp(argv[i], names[b]); b++) {}
+        if (b == 3) {
+            fprintf(stderr, "Unknown backend %s\n", argv[i]);
+            return 1;
+        }
+        // In a child of its own, so that a backend the kernel doesn't support only skips itself.
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_backend(backends[b], names[b]);
+            exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            printf("%-7s not available\n", names[b]);
+        }
+    }
+    return 0;
+}
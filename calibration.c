@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "scheduler.h"
+
+/* Persistent cache of the measured time unit.
+ *
+ * Measuring the time unit takes UNIT_MEASURE_REPEAT units (about 1.7s) on every run.
+ * The result only depends on the machine and on the code of run_single_unit(), so it is
+ * cached in a text file, one "<key> <time unit in ns>" line per machine, in
+ * $XDG_CACHE_HOME (~/.cache by default) rather than wherever the scheduler is run from.
+ * The key is a hash of the CPU model, the cpufreq governor and the inode, size and
+ * modification time of the scheduler binary, so a different CPU, a different governor or a
+ * rebuilt binary gets its own measurement, without reading the whole binary on every run.
+ */
+
+#define CALIBRATION_CACHE_MAX_ENTRIES 64
+#define CALIBRATION_LINE_MAX 256
+#define CALIBRATION_CACHE_NAME "os_pj1_time_unit"
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+typedef struct CalibrationEntry {
+    uint64_t key;
+    int64_t time_unit_ns;
+} CalibrationEntry;
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/* Hashes the whole file, or only the first line starting with prefix if prefix isn't NULL.
+ * A file that can't be read hashes as if it were empty. */
+static uint64_t hash_file(uint64_t hash, const char *path, const char *prefix) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return hash;
+    }
+    if (prefix != NULL) {
+        char line[CALIBRATION_LINE_MAX];
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            if (!strncmp(line, prefix, strlen(prefix))) {
+                hash = fnv1a(hash, line, strlen(line));
+                break;
+            }
+        }
+    } else {
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+            hash = fnv1a(hash, buf, n);
+        }
+    }
+    fclose(fp);
+    return hash;
+}
+
+static uint64_t calibration_key(void) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    hash = hash_file(hash, "/proc/cpuinfo", "model name");
+    hash = hash_file(hash, "/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor", NULL);
+    struct stat binary;
+    if (stat("/proc/self/exe", &binary) == 0) {
+        hash = fnv1a(hash, &binary.st_dev, sizeof(binary.st_dev));
+        hash = fnv1a(hash, &binary.st_ino, sizeof(binary.st_ino));
+        hash = fnv1a(hash, &binary.st_size, sizeof(binary.st_size));
+        hash = fnv1a(hash, &binary.st_mtim, sizeof(binary.st_mtim));
+    }
+    return hash;
+}
+
+/* $XDG_CACHE_HOME/CALIBRATION_CACHE_NAME, or ~/.cache/CALIBRATION_CACHE_NAME when it isn't set.
+ * NULL, so that nothing is cached, when neither variable is set. */
+const char *calibration_cache_default(void) {
+    static char path[PATH_MAX];
+    const char *dir = getenv("XDG_CACHE_HOME");
+    int len;
+    if (dir != NULL && dir[0] == '/') {
+        len = snprintf(path, sizeof(path), "%s/" CALIBRATION_CACHE_NAME, dir);
+    } else if ((dir = getenv("HOME")) != NULL && dir[0] == '/') {
+        len = snprintf(path, sizeof(path), "%s/.cache/" CALIBRATION_CACHE_NAME, dir);
+    } else {
+        return NULL;
+    }
+    return len < (int) sizeof(path) ? path : NULL;
+}
+
+/* Creates the directories of the cache, as ~/.cache may not exist yet. */
+static void make_cache_dirs(const char *path) {
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char *slash = strchr(dir + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        mkdir(dir, 0700); // Fails harmlessly if it exists; fopen() reports any other error.
+        *slash = '/';
+    }
+}
+
+static int read_entries(const char *path, CalibrationEntry *entries) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    int count = 0;
+    while (count < CALIBRATION_CACHE_MAX_ENTRIES &&
+            fscanf(fp, "%" SCNx64 " %" SCNd64, &entries[count].key, &entries[count].time_unit_ns) == 2) {
+        count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+bool calibration_cache_load(const char *path, int64_t *time_unit_ns) {
+    CalibrationEntry entries[CALIBRATION_CACHE_MAX_ENTRIES];
+    int count = read_entries(path, entries);
+    uint64_t key = calibration_key();
+    for (int i = 0; i < count; i++) {
+        if (entries[i].key == key && entries[i].time_unit_ns > 0) {
+            *time_unit_ns = entries[i].time_unit_ns;
+            return true;
+        }
+    }
+    return false;
+}
+
+void calibration_cache_store(const char *path, int64_t time_unit_ns) {
+    CalibrationEntry entries[CALIBRATION_CACHE_MAX_ENTRIES];
+    int count = read_entries(path, entries);
+    uint64_t key = calibration_key();
+    int i;
+    for (i = 0; i < count && entries[i].key != key; i++) {}
+    if (i == CALIBRATION_CACHE_MAX_ENTRIES) {
+        i = 0; // The cache is full; replace the first entry.
+    }
+    entries[i].key = key;
+    entries[i].time_unit_ns = time_unit_ns;
+    if (i == count) {
+        count++;
+    }
+
+    make_cache_dirs(path);
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        perror("Can't write the calibration cache");
+        return; // Not fatal; the next run measures again.
+    }
+    for (i = 0; i < count; i++) {
+        fprintf(fp, "%016" PRIx64 " %" PRId64 "\n", entries[i].key, entries[i].time_unit_ns);
+    }
+    fclose(fp);
+}
@@ -0,0 +1,134 @@
+#define _GNU_SOURCE // sched_setaffinity() and the CPU_* macros
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "scheduler.h"
+
+/* Per-CPU run queues.
+ *
+ * With --cpus N, every scheduler keeps one run queue per CPU, and the event dispatchers select
+ * the queue a call works on with current_cpu. A process that arrives goes to the CPU with the
+ * shortest queue and is pinned to it with sched_setaffinity(), so the SCHED_FIFO priorities set by
+ * suspend_process() and resume_process() only compete with the processes of the same CPU.
+ * When the last process of a CPU terminates, the CPU steals the process that the CPU with
+ * the longest queue would run next.
+ */
+
+int num_cpus = 1;
+int current_cpu = 0;
+
+static int *cpu_ids = NULL; // The CPU each run queue is pinned to. NULL if nothing is pinned.
+static bool *busy; // Indexed by run queue. Whether the queue was empty at the last event.
+static double *busy_time; // Indexed by run queue. Time units during which the queue wasn't empty.
+static double last_event_time = 0;
+static int steal_count = 0;
+static double single_cpu_makespan = 0; // Of the processes that have arrived
+
+void cpus_init(int n, bool pin) {
+    num_cpus = n;
+    busy = (bool *) calloc(n, sizeof(bool));
+    busy_time = (double *) calloc(n, sizeof(double));
+    if (!pin || simulation_mode) {
+        return;
+    }
+
+    // Use the first n CPUs the scheduler itself is allowed to run on.
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        perror("sched_getaffinity error!!!");
+        exit(1);
+    }
+    if (CPU_COUNT(&allowed) < n) {
+        fprintf(stderr, "--cpus %d: only %d CPUs are available\n", n, CPU_COUNT(&allowed));
+        exit(1);
+    }
+    cpu_ids = (int *) malloc(sizeof(int) * n);
+    for (int cpu = 0, i = 0; i < n; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            cpu_ids[i++] = cpu;
+        }
+    }
+}
+
+int least_loaded_cpu(void) {
+    int best = 0, shortest = -1;
+    for (current_cpu = 0; current_cpu < num_cpus; current_cpu++) {
+        int length = queue_length();
+        if (shortest < 0 || length < shortest) {
+            best = current_cpu;
+            shortest = length;
+        }
+    }
+    return best;
+}
+
+void move_process(ProcessInfo *p, int cpu) {
+    if (p->cpu == cpu) {
+        return;
+    }
+    if (simulation_mode) {
+        sim_move_process(p->pid, cpu);
+    } else if (cpu_ids != NULL) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu_ids[cpu], &set);
+        if (sched_setaffinity(p->pid, sizeof(set), &set) == -1) {
+            perror("Can't pin a process to its CPU!");
+            scheduler_exit(1);
+        }
+    }
+    p->cpu = cpu;
+}
+
+void steal_work(int thief) {
+    int victim = -1, longest = 1; // A queue of one process has nothing waiting.
+    for (current_cpu = 0; current_cpu < num_cpus; current_cpu++) {
+        int length = queue_length();
+        if (current_cpu != thief && length > longest) {
+            victim = current_cpu;
+            longest = length;
+        }
+    }
+    if (victim < 0) {
+        return;
+    }
+    current_cpu = victim;
+    ProcessInfo *p = steal_process();
+    if (p == NULL) {
+        return;
+    }
+    move_process(p, thief);
+    admit_process(p);
+    steal_count++;
+}
+
+void cpus_account(double now) {
+    for (current_cpu = 0; current_cpu < num_cpus; current_cpu++) {
+        if (busy[current_cpu]) {
+            busy_time[current_cpu] += now - last_event_time;
+        }
+        busy[current_cpu] = queue_length() > 0;
+    }
+    last_event_time = now;
+}
+
+/* Every scheduler here is work-conserving, so on one CPU they all finish at the same time:
+ * each process starts when it arrives or when the one that arrived before it finishes. */
+void cpus_arrival(ProcessInfo *p) {
+    if (p->arrival_time > single_cpu_makespan) {
+        single_cpu_makespan = p->arrival_time;
+    }
+    single_cpu_makespan += p->time_needed;
+}
+
+void cpus_print_stats(void) {
+    double makespan = last_event_time;
+    for (int cpu = 0; cpu < num_cpus; cpu++) {
+        fprintf(stderr, "cpu %d: %.1f%% busy\n", cpu_ids != NULL ? cpu_ids[cpu] : cpu,
+                makespan > 0 ? 100.0 * busy_time[cpu] / makespan : 0.0);
+    }
+    double single = single_cpu_makespan;
+    fprintf(stderr, "makespan: %.1f time units on %d CPUs, %.1f on one CPU (speedup %.2fx)\n",
+            makespan, num_cpus, single, makespan > 0 ? single / makespan : 1.0);
+    fprintf(stderr, "%d processes were stolen by idle CPUs\n", steal_count);
+}
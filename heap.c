@@ -1,85 +1,334 @@
+#include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include "scheduler.h"
 
-void heap_init(Heap* h, int max_size) {
-     h->pq = (ProcessInfo**)malloc(sizeof(ProcessInfo*) * max_size);
+/* A 4-ary min-heap of (remaining time, pid) keys, stored inline next to the process they belong to.
+ * EDF orders its heap by (edf_deadline, pid) instead, and SJF/PSJF with aging by an aged key.
+ *
+ * A sift compares a node with its four children, which are 4 * 16 bytes and start on a
+ * cache line boundary, so each level costs one cache line and never touches ProcessInfo.
+ * Node i lives in nodes[i + HEAP_PADDING]; the padding puts the children 4i+1 .. 4i+4 of
+ * every node at a multiple of four.
+ * Each process records its position in heap_index, so its key can be updated in place.
+ *
+ * Large heaps put most nodes in a radix heap instead. Its bucket i > 0 holds the keys whose
+ * highest bit differing from the last minimum is bit i - 1, and bucket 0 the last minimum
+ * itself. Taking a minimum from bucket 0 is O(1); when it is empty, the first non-empty
+ * bucket is spread over the lower ones, so a node moves down at most 64 times in all.
+ * This only works while no key is below the last minimum, which SJF breaks when a short
+ * job arrives and PSJF when the running job's remaining time goes down. Such keys go to
+ * the 4-ary heap, and the top is the smaller of the two tops.
+ *
+ * Arrays double when they are full and halve when they are a quarter full, so memory
+ * follows the number of processes waiting, not the number in the workload.
+ */
+
+#define HEAP_ARITY 4
+#define HEAP_PADDING (HEAP_ARITY - 1)
+#define CACHE_LINE 64
+#define RADIX_MIN_SIZE 4096 // Below this, the 4-ary heap is faster on its own.
+#define HEAP_INITIAL_CAPACITY 64
+#define RADIX_BUCKET_INITIAL_CAPACITY 16
+
+int aging_rate = 0;
+
+static void heap_resize(Heap *h, int capacity) {
+     size_t bytes = sizeof(HeapNode) * (capacity + HEAP_PADDING);
+     bytes = (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE; // aligned_alloc() needs a multiple
+     HeapNode *nodes = (HeapNode *) aligned_alloc(CACHE_LINE, bytes) + HEAP_PADDING;
+     if (h->nodes != NULL) {
+          memcpy(nodes, h->nodes, sizeof(HeapNode) * h->heap_size);
+          free(h->nodes - HEAP_PADDING);
+     }
+     h->nodes = nodes;
+     h->heap_capacity = capacity;
+}
+
+static void heap_shrink(Heap *h) {
+     int capacity = h->heap_capacity;
+     while (capacity > HEAP_INITIAL_CAPACITY && h->heap_size <= capacity / 4) {
+          capacity /= 2;
+     }
+     if (capacity != h->heap_capacity) {
+          heap_resize(h, capacity);
+     }
+}
+
+void heap_init_radix(Heap *h, bool radix) {
+     h->nodes = NULL;
      h->heap_size = 0;
+     heap_resize(h, HEAP_INITIAL_CAPACITY);
+     h->radix = radix;
+     h->key = REMAINING_TIME_KEY;
+     h->radix_last = 0;
+     h->radix_size = 0;
+     for (int i = 0; i < RADIX_BUCKETS; i++) {
+          h->buckets[i] = (RadixBucket) {NULL, 0, 0};
+     }
 }
 
-static bool heap_element_lt(Heap *h, int lhsIdx, int rhsIdx) {
-    const ProcessInfo *lhs = h->pq[lhsIdx];
-    const ProcessInfo *rhs = h->pq[rhsIdx];
-    if (lhs->remaining_time == rhs->remaining_time) {
-        return lhs->pid < rhs->pid;
-    }
-    return lhs->remaining_time < rhs->remaining_time;
+void heap_init(Heap* h, int expected_size) {
+     heap_init_radix(h, expected_size >= RADIX_MIN_SIZE);
+}
+
+void heap_init_key(Heap *h, int expected_size, HeapKey key) {
+     heap_init(h, expected_size);
+     h->key = key;
+}
+
+/* The remaining time SJF and PSJF see: with --predict, a process may run longer than predicted,
+ * and then it is expected to terminate any moment. */
+static int predicted_remaining_time(ProcessInfo *p) {
+     int remaining = p->remaining_time + p->prediction_error;
+     return remaining > 0 ? remaining : 0;
+}
+
+static int process_key(Heap *h, ProcessInfo *p) {
+     switch (h->key) {
+          case DEADLINE_KEY:
+               return p->edf_deadline;
+          case AGED_KEY:
+               return predicted_remaining_time(p) + p->wait_origin / aging_rate;
+          default:
+               return predicted_remaining_time(p);
+     }
 }
 
-static int lchild(int parentIdx) {
-    return parentIdx * 2 + 1;
+void heap_free(Heap *h) {
+     free(h->nodes - HEAP_PADDING);
+     for (int i = 0; i < RADIX_BUCKETS; i++) {
+          free(h->buckets[i].nodes);
+     }
 }
 
-static int rchild(int parentIdx) {
-    return parentIdx * 2 + 2;
+static bool heap_node_lt(const HeapNode *lhs, const HeapNode *rhs) {
+    if (lhs->key == rhs->key) {
+        return lhs->pid < rhs->pid;
+    }
+    return lhs->key < rhs->key;
+}
+
+static int first_child(int parentIdx) {
+    return parentIdx * HEAP_ARITY + 1;
 }
 
 static int parent(int childIdx) {
-    return (childIdx - 1)/2;
+    return (childIdx - 1) / HEAP_ARITY;
 }
 
-static void heap_swap(Heap *h, int lhs, int rhs) {
-     ProcessInfo *temp = h->pq[lhs];
-     h->pq[lhs] = h->pq[rhs];
-     h->pq[rhs] = temp;
+static void heap_place(Heap *h, int idx, HeapNode node) {
+     h->nodes[idx] = node;
+     node.process->heap_index = idx;
 }
 
+/* Both sifts move the node being placed only once, at the end. */
 static void upheap(Heap *h, int childIdx) {
-     int parentIdx = (childIdx - 1) / 2;
-     while (childIdx > 0 && heap_element_lt(h, childIdx, parentIdx)) {
-          heap_swap(h, parentIdx, childIdx);
+     HeapNode node = h->nodes[childIdx];
+     while (childIdx > 0) {
+          int parentIdx = parent(childIdx);
+          if (!heap_node_lt(&node, &h->nodes[parentIdx])) {
+               break;
+          }
+          heap_place(h, childIdx, h->nodes[parentIdx]);
           childIdx = parentIdx;
-          parentIdx = (childIdx - 1) / 2;
      }
+     heap_place(h, childIdx, node);
 }
 
-void heap_insert(Heap *h, ProcessInfo *p) {
+static void downheap(Heap *h, int parentIdx) {
+     HeapNode node = h->nodes[parentIdx];
+     while (first_child(parentIdx) < h->heap_size) {
+          int minIdx = first_child(parentIdx);
+          int last = minIdx + HEAP_ARITY < h->heap_size ? minIdx + HEAP_ARITY : h->heap_size;
+          for (int c = minIdx + 1; c < last; c++) {
+               if (heap_node_lt(&h->nodes[c], &h->nodes[minIdx])) {
+                    minIdx = c;
+               }
+          }
+          if (!heap_node_lt(&h->nodes[minIdx], &node)) {
+               break;
+          }
+          heap_place(h, parentIdx, h->nodes[minIdx]);
+          parentIdx = minIdx;
+     }
+     heap_place(h, parentIdx, node);
+}
+
+/* (key, pid) as one integer in the same order; the key is signed. */
+static uint64_t radix_key(const HeapNode *node) {
+     return (uint64_t) ((uint32_t) node->key ^ 0x80000000u) << 32 | (uint32_t) node->pid;
+}
+
+static int radix_bucket_of(Heap *h, uint64_t key) {
+     return key == h->radix_last ? 0 : 64 - __builtin_clzll(key ^ h->radix_last);
+}
+
+static void radix_push(Heap *h, int bucket, HeapNode node) {
+     RadixBucket *b = &h->buckets[bucket];
+     if (b->size == b->capacity) {
+          b->capacity = b->capacity ? b->capacity * 2 : RADIX_BUCKET_INITIAL_CAPACITY;
+          b->nodes = (HeapNode *) realloc(b->nodes, sizeof(HeapNode) * b->capacity);
+     }
+     b->nodes[b->size] = node;
+     node.process->heap_index = b->size;
+     node.process->heap_bucket = bucket;
+     b->size++;
+}
+
+static void radix_shrink(RadixBucket *b) {
+     int capacity = b->capacity;
+     while (capacity > RADIX_BUCKET_INITIAL_CAPACITY && b->size <= capacity / 4) {
+          capacity /= 2;
+     }
+     if (capacity != b->capacity) {
+          b->capacity = capacity;
+          b->nodes = (HeapNode *) realloc(b->nodes, sizeof(HeapNode) * capacity);
+     }
+}
+
+static void radix_remove(Heap *h, int bucket, int idx) {
+     RadixBucket *b = &h->buckets[bucket];
+     b->nodes[idx].process->heap_index = -1;
+     b->size--;
+     if (idx < b->size) {
+          b->nodes[idx] = b->nodes[b->size];
+          b->nodes[idx].process->heap_index = idx;
+     }
+     h->radix_size--;
+     radix_shrink(b);
+}
+
+/* Makes bucket 0 hold the minimum of the radix heap, unless it is empty. */
+static void radix_settle(Heap *h) {
+     if (h->radix_size == 0 || h->buckets[0].size > 0) {
+          return;
+     }
+     int i = 1;
+     while (h->buckets[i].size == 0) {
+          i++;
+     }
+     RadixBucket *b = &h->buckets[i];
+     uint64_t min_key = radix_key(&b->nodes[0]);
+     for (int j = 1; j < b->size; j++) {
+          uint64_t key = radix_key(&b->nodes[j]);
+          if (key < min_key) {
+               min_key = key;
+          }
+     }
+     // Every key in bucket i now differs from the minimum in a lower bit.
+     h->radix_last = min_key;
+     int size = b->size;
+     b->size = 0;
+     for (int j = 0; j < size; j++) {
+          HeapNode node = b->nodes[j];
+          radix_push(h, radix_bucket_of(h, radix_key(&node)), node);
+     }
+     radix_shrink(b);
+}
+
+static void insert_node(Heap *h, HeapNode node) {
+     uint64_t key = radix_key(&node);
+     if (h->radix && (h->radix_size == 0 || key >= h->radix_last)) {
+          if (h->radix_size == 0) {
+               h->radix_last = key;
+          }
+          radix_push(h, radix_bucket_of(h, key), node);
+          h->radix_size++;
+          return;
+     }
+     node.process->heap_bucket = -1;
+     if (h->heap_size == h->heap_capacity) {
+          heap_resize(h, h->heap_capacity * 2);
+     }
      int childIdx = h->heap_size;
-     h->pq[childIdx] = p;
+     h->nodes[childIdx] = node;
      h->heap_size++;
-     upheap(h,childIdx);
+     upheap(h, childIdx);
 }
 
-ProcessInfo *heap_top(Heap *h) {
-     return h->pq[0];
+void heap_insert(Heap *h, ProcessInfo *p) {
+     insert_node(h, (HeapNode) {process_key(h, p), p->pid, p});
 }
 
-static void downheap(Heap *h, int parentIdx) {
-     while(lchild(parentIdx) < h->heap_size) {
-         int minIdx = parentIdx;
-         if (heap_element_lt(h, lchild(parentIdx), minIdx)) { 
-             minIdx = lchild(parentIdx);
-         }
-         if (rchild(parentIdx) < h->heap_size && heap_element_lt(h, rchild(parentIdx), minIdx)) {
-             minIdx = rchild(parentIdx);
-         }
-         if (parentIdx == minIdx) {
-             break;
-         } 
-         heap_swap(h, parentIdx, minIdx);
-         parentIdx = minIdx;
+/* Whether the top is in the radix heap rather than the 4-ary one. */
+static bool top_in_radix(Heap *h) {
+     radix_settle(h);
+     if (h->radix_size == 0) {
+          return false;
+     }
+     return h->heap_size == 0 || heap_node_lt(&h->buckets[0].nodes[0], &h->nodes[0]);
+}
+
+ProcessInfo *heap_top(Heap *h) {
+     if (top_in_radix(h)) {
+          return h->buckets[0].nodes[0].process;
      }
+     return h->nodes[0].process;
 }
 
 void heap_pop(Heap *h) {
+     heap_remove(h, heap_top(h));
+}
+
+void heap_remove(Heap *h, ProcessInfo *p) {
+     int idx = p->heap_index;
+     if (p->heap_bucket >= 0) {
+          assert(idx >= 0 && idx < h->buckets[p->heap_bucket].size && h->buckets[p->heap_bucket].nodes[idx].process == p);
+          radix_remove(h, p->heap_bucket, idx);
+          return;
+     }
+     assert(idx >= 0 && idx < h->heap_size && h->nodes[idx].process == p);
+     p->heap_index = -1;
      h->heap_size--;
-     heap_swap(h, h->heap_size, 0);
-     downheap(h, 0);
+     if (idx < h->heap_size) {
+          // The last node takes its place, and may belong above or below it.
+          h->nodes[idx] = h->nodes[h->heap_size];
+          if (idx > 0 && heap_node_lt(&h->nodes[idx], &h->nodes[parent(idx)])) {
+               upheap(h, idx);
+          } else {
+               downheap(h, idx);
+          }
+     }
+     heap_shrink(h);
+}
+
+void heap_update(Heap *h, ProcessInfo *p) {
+     int idx = p->heap_index;
+     if (p->heap_bucket >= 0) {
+          assert(idx >= 0 && idx < h->buckets[p->heap_bucket].size && h->buckets[p->heap_bucket].nodes[idx].process == p);
+          // The new key may be below the last minimum, so it is inserted again.
+          radix_remove(h, p->heap_bucket, idx);
+          heap_insert(h, p);
+          return;
+     }
+     assert(idx >= 0 && idx < h->heap_size && h->nodes[idx].process == p);
+     int old_key = h->nodes[idx].key;
+     h->nodes[idx].key = process_key(h, p);
+     if (h->nodes[idx].key < old_key) {
+          upheap(h, idx);
+     } else {
+          downheap(h, idx);
+     }
+}
+
+int heap_processes(Heap *h, ProcessInfo **processes) {
+     int count = 0;
+     for (int i = 0; i < h->heap_size; i++) {
+          processes[count++] = h->nodes[i].process;
+     }
+     for (int bucket = 0; bucket < RADIX_BUCKETS; bucket++) {
+          for (int i = 0; i < h->buckets[bucket].size; i++) {
+               processes[count++] = h->buckets[bucket].nodes[i].process;
+          }
+     }
+     return count;
 }
 
 int heap_size(Heap *h) {
-     return h->heap_size;
+     return h->heap_size + h->radix_size;
 }
 
 bool heap_empty(Heap *h) {
-    return h->heap_size == 0;
+    return heap_size(h) == 0;
 }
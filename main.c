@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // SCHED_RESET_ON_FORK
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
@@ -6,139 +7,232 @@
 #include <signal.h>
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdbool.h>
 
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
 
-#define PROCESS_NAME_MAX 100
 #define BILLION 1000000000L
 #define UNIT_MEASURE_REPEAT 1000
-#define RR_TIMES_OF_UNIT 500
+#define UNIT_CHECK_REPEAT 50 // A quick measurement to check that the cached time unit is still right
+#define CALIBRATION_DRIFT_PERCENT 2
+#define RECALIBRATION_GAIN 0.25 // The fraction of the measured error that is corrected at once
+#define RECALIBRATION_MAX_STEP_PERCENT 1 // A single correction changes the time unit by at most this much
+#define RECALIBRATION_MIN_UNITS 10 // Shorter processes are too noisy to learn from
 #define CLOCKID CLOCK_MONOTONIC
+#define POOL_DEFAULT_SIZE 8
+#define EPOLL_MAX_EVENTS 64
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434 // Linux 5.3 and later
+#endif
 
 #include "scheduler.h"
 
 typedef struct TimerInfo {
-    timer_t timer_id;
+    timer_t timer_id; // Used by the sigsuspend event loop
+    int timer_fd; // Used by the epoll event loop
     struct timespec time_unit;
-    struct timespec arrival_remaining;
-    struct timespec timeslice_remaining;
+    /* Every arrival and every end of a time slice is due at epoch + (time units - epoch_units) * time_unit.
+     * With --abstime these deadlines are queued as they are, so the latency of handling one event
+     * doesn't delay all the following ones. Otherwise the next deadline is counted from the moment
+     * the previous event of its kind is handled, read once for all the events handled together,
+     * so that events due together stay together.
+     * When --recalibrate corrects time_unit, the epoch moves to that moment, so that deadlines
+     * which have already passed stay where they were. */
+    struct timespec epoch;
+    double epoch_units;
+    int timeslice_end; // Time units since the epoch at which the time slice in progress ends
+    struct timespec arrival_base, timeslice_base; // When the previous arrival and end of a time slice were handled
+    TimerQueue queue; // The pending arrival and time slice timers. The kernel timer is armed with the earliest.
+    bool arrival_queued; // Whether the next arrival is in the queue. With --stream, it may not be known yet.
 }TimerInfo;
 
+/* Sent by a child through unit_report_fd when it terminates */
+typedef struct UnitReport {
+    int time_needed;
+    int64_t cpu_ns; // CPU time the child spent running its time units
+    int64_t start_latency_ns; // From its scheduled arrival until it started running
+} UnitReport;
+
+typedef struct LatencyStats {
+    int64_t total_ns;
+    int64_t max_ns;
+    int count;
+} LatencyStats;
+
+typedef enum EventLoop {
+    SIGSUSPEND_LOOP, EPOLL_LOOP
+} EventLoop;
+
+/* The kind of an event source registered with epoll, stored in the lower bits of epoll_data.
+ * The upper bits of a CHILD_SOURCE hold the pidfd of the child. */
+typedef enum EventSource {
+    TIMER_SOURCE, SIGNAL_SOURCE, CHILD_SOURCE, INPUT_SOURCE
+} EventSource;
+#define EVENT_SOURCE_BITS 2
+
 /* Global variables */
 ScheduleStrategy current_strategy;
+bool simulation_mode = false;
 static int num_process; // Number of processes s
+static int worker_pool_size = POOL_DEFAULT_SIZE;
+static bool print_stats = false;
+static EventLoop event_loop = SIGSUSPEND_LOOP;
+static bool absolute_timers = false;
+static const char *calibration_cache_path; // NULL if the cache is disabled
+static bool time_unit_cached = false;
+static const char *predict_path = NULL; // Set by --predict
+static bool recalibrate = false;
+static int unit_report_fd[2] = {-1, -1};
+static int64_t measured_time_unit_ns; // The time unit before any correction by --recalibrate
+static int recalibration_count = 0;
+static int requested_cpus = 0; // 0 without --cpus
+static SwitchBackend requested_switch = PRIORITY_SWITCH;
+static bool convert = false; // Set by --convert, which writes the input in convert_format instead of running it
+static WorkloadFormat convert_format;
+static bool stream = false; // Set by --stream, which reads the processes as they arrive and frees them when they terminate
 
 /* private static variables */
 static ProcessInfo *all_process_info;
-static ProcessInfo *arrival_ptr;
 static volatile sig_atomic_t event_type;
+static int epoll_fd = -1; // Only used by the epoll event loop
+static ProcessInfo **child_of_pidfd; // Indexed by pidfd. Only used by the epoll event loop.
+static int child_of_pidfd_size;
+/* The children that have arrived and not terminated, by pid. Only used by the sigsuspend event loop,
+ * where SIGCHLD tells only a pid. */
+static PidTable process_of_pid;
 
 /* fork a child */
-static pid_t fork_a_child(int);
+static pid_t fork_a_child(int, int64_t);
 
 /* functions for interaction with scheduler */
 
+/* The built-in policies, indexed by ScheduleStrategy */
+static const SchedulerOps *const builtin_policies[] = {
+    [FIFO] = &FIFO_ops, [RR] = &RR_ops, [SJF] = &SJF_ops, [PSJF] = &PSJF_ops, [MLFQ] = &MLFQ_ops,
+    [EDF] = &EDF_ops, [CFS] = &CFS_ops, [STRIDE] = &STRIDE_ops, [LOTTERY] = &LOTTERY_ops, [HRRN] = &HRRN_ops,
+};
+static const SchedulerOps *plugin_ops; // Loaded by str_to_strategy() when current_strategy is PLUGIN
+
+const SchedulerOps *scheduler_ops;
+
 void set_strategy(ScheduleStrategy s, int max_process) {
-    switch (s) {
-        case FIFO:
-            set_strategy_FIFO(max_process);
-            break;
-        case RR:
-            set_strategy_RR(max_process);
-            break;
-        case SJF:
-            set_strategy_SJF(max_process);
-            break;
-        case PSJF:
-            set_strategy_PSJF(max_process);
-            break;
+    scheduler_ops = s == PLUGIN ? plugin_ops : builtin_policies[s];
+    scheduler_ops->set_strategy(max_process);
+}
+
+/* Arrival-to-runnable latency, from the time a process is due to arrive until the scheduler can run
+ * its child, so it counts how late the arrival was handled; and arrival-to-start latency, until the
+ * child has started running, reported by the child, so it also counts the fork or the wakeup of a
+ * parked worker from its pipe, and the time the process waited for its turn. */
+static LatencyStats arrival_latency, start_latency;
+static int pool_hit_count = 0;
+/* Timer lateness, i.e. how long after its deadline an arrival or the end of a time slice is handled. */
+static LatencyStats arrival_lateness, timeslice_lateness;
+static void record_latency(LatencyStats *stats, struct timespec begin);
+static void record_latency_ns(LatencyStats *stats, int64_t latency_ns);
+static int64_t timespec_to_ns(struct timespec timespec);
+static void print_latency(const char *what, LatencyStats *stats);
+static void watch_child(ProcessInfo *p);
+
+/* arrival is when p is due to arrive. */
+static void add_process(ProcessInfo *p, struct timespec arrival) {
+    int64_t arrival_ns = timespec_to_ns(arrival);
+    p->pid = pool_dispatch(p->time_needed, arrival_ns);
+    if (p->pid != 0) {
+        pool_hit_count++; // The worker was suspended when it was parked.
+    } else {
+        p->pid = fork_a_child(p->time_needed, arrival_ns);
+        suspend_process(p->pid);
+    }
+    record_latency(&arrival_latency, arrival);
+    if (event_loop == EPOLL_LOOP) {
+        watch_child(p);
+    } else {
+        pid_table_insert(&process_of_pid, p->pid, p);
+    }
+    if (stream) {
+        printf("%s %d\n", p->name, p->pid); // Without --stream, every process is printed after the run.
     }
+    admit_process(p);
 }
 
-void add_process(ProcessInfo *p) {
-    p->pid = fork_a_child(p->time_needed);
-    suspend_process(p->pid);
-    switch (current_strategy) {
-        case FIFO:
-            add_process_FIFO(p);
-            break;
-        case RR:
-            add_process_RR(p);
-            break;
-        case SJF:
-            add_process_SJF(p);
-            break;
-        case PSJF:
-            add_process_PSJF(p);
-            break;
+/* A process that hasn't been placed on a CPU yet goes to the one with the shortest queue. */
+void admit_process(ProcessInfo *p) {
+    if (p->cpu < 0) {
+        predict_arrival(p);
+        cpus_arrival(p);
+        move_process(p, least_loaded_cpu());
     }
+    current_cpu = p->cpu;
+    scheduler_ops->add_process(p);
 }
 
-void remove_current_process(void) {
-    switch (current_strategy) {
-        case FIFO:
-            remove_current_process_FIFO();
-            break;
-        case RR:
-            remove_current_process_RR();
-            break;
-        case SJF:
-            remove_current_process_SJF();
-            break;
-        case PSJF:
-            remove_current_process_PSJF();
-            break;
+void remove_current_process(int cpu) {
+    current_cpu = cpu;
+    scheduler_ops->remove_current_process();
+    if (num_cpus > 1 && queue_length() == 0) {
+        steal_work(cpu);
+    }
+}
+
+void timeslice_over(long now) {
+    assert(scheduler_ops->timeslice_over != NULL); // Only the policies with time slices have a time slice timer.
+    for (current_cpu = 0; current_cpu < num_cpus; current_cpu++) {
+        scheduler_ops->timeslice_over(now);
     }
 }
 
-void timeslice_over(void) {
-    assert(current_strategy == RR);
-    timeslice_over_RR();
+int timeslice_length(void) {
+    return scheduler_ops->timeslice_length != NULL ? scheduler_ops->timeslice_length() : 0;
 }
 
 void context_switch(void) {
-    switch (current_strategy) {
-        case FIFO:
-            context_switch_FIFO();
-            break;
-        case RR:
-            context_switch_RR();
-            break;
-        case SJF:
-            context_switch_SJF();
-            break;
-        case PSJF:
-            context_switch_PSJF();
-            break;
+    for (current_cpu = 0; current_cpu < num_cpus; current_cpu++) {
+        scheduler_ops->context_switch();
     }
 }
 
-static bool scheduler_empty(void) {
-    switch (current_strategy) {
-        case FIFO:
-            return scheduler_empty_FIFO();
-        case RR:
-            return scheduler_empty_RR();
-        case SJF:
-            return scheduler_empty_SJF();
-        case PSJF:
-            return scheduler_empty_PSJF();
+bool scheduler_empty(void) {
+    for (current_cpu = 0; current_cpu < num_cpus; current_cpu++) {
+        if (!scheduler_ops->scheduler_empty()) {
+            return false;
+        }
     }
-    assert(0); //impossible to arrive here
+    return true;
+}
+
+int queue_length(void) {
+    return scheduler_ops->queue_length();
+}
+
+ProcessInfo *steal_process(void) {
+    return scheduler_ops->steal_process();
 }
 
 /* For control kernel scheduler */
-static void set_my_priority(int priority);
 static void set_parent_priority(void);
-static void set_child_priority(void);
+static void set_child_priority(pid_t pid);
 
-pid_t my_fork() {
+pid_t my_fork(void) {
     pid_t fork_res = fork();
     if (fork_res == 0) {
-        set_child_priority();
+        // The signals blocked for the event loop should still reach the children.
+        sigset_t empty_set;
+        sigemptyset(&empty_set);
+        sigprocmask(SIG_SETMASK, &empty_set, NULL);
+    } else if (fork_res > 0) {
+        // Set by the parent: a child setting it itself could undo a suspend_process() that came first.
+        set_child_priority(fork_res);
+        switch_attach(fork_res);
     }
     return fork_res;
 }
@@ -146,23 +240,41 @@ pid_t my_fork() {
 void sys_log_process_start(ProcessTimeRecord *);
 void sys_log_process_end(ProcessTimeRecord *);
 
-pid_t fork_a_child(int child_run_time) {
+pid_t fork_a_child(int child_run_time, int64_t arrival_ns) {
     pid_t child_pid = my_fork();
     if (child_pid != 0){
         return child_pid;
     } 
+    run_child(child_run_time, arrival_ns);
+}
+
+void run_child(int child_run_time, int64_t arrival_ns) {
+    struct timespec start;
+    clock_gettime(CLOCKID, &start);
     ProcessTimeRecord time_record;
     time_record.pid = getpid();
     sys_log_process_start(&time_record);
+    struct timespec cpu_begin, cpu_end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_begin);
     for(int i = 0; i < child_run_time; i++) {
         run_single_unit();
     }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+    if (unit_report_fd[1] >= 0) {
+        // Smaller than PIPE_BUF, so reports from different children are never interleaved.
+        UnitReport report;
+        report.time_needed = child_run_time;
+        report.cpu_ns = (cpu_end.tv_sec - cpu_begin.tv_sec) * BILLION + (cpu_end.tv_nsec - cpu_begin.tv_nsec);
+        report.start_latency_ns = start.tv_sec * BILLION + start.tv_nsec - arrival_ns;
+        if (write(unit_report_fd[1], &report, sizeof(report)) != sizeof(report)) {
+            perror("Can't report the time unit");
+        }
+    }
     sys_log_process_end(&time_record);
     exit(0);
 }
 
 /* IO fnts */
-static void read_process_info();
 static ScheduleStrategy str_to_strategy(char strat[]);
 
 /* Block some signals */
@@ -182,218 +294,693 @@ static void costumize_signal_handlers(void) {
     sigemptyset(&sig_act.sa_mask);
     sig_act.sa_handler = signal_handler;
     sigaction(SIGALRM, &sig_act, NULL);
+    sig_act.sa_flags = SA_NOCLDSTOP; // --switch signal stops and continues children.
     sigaction(SIGCHLD, &sig_act, NULL);
+    /* SIGIO only interrupts sigsuspend(): the input is polled after every event, so that it
+     * doesn't overwrite a SIGCHLD or SIGALRM delivered with it. */
+    sig_act.sa_flags = 0;
+    sigaction(SIGIO, &sig_act, NULL);
 }
 
 static struct timespec timespec_multiply(struct timespec, int);
 static struct timespec timespec_divide(struct timespec, int);
 static struct timespec timespec_subtract(struct timespec, struct timespec);
-static struct timespec measure_time_unit(void);
+static struct timespec timespec_add(struct timespec, struct timespec);
+static struct timespec measure_time_unit(int repeat);
+static struct timespec calibrate_time_unit(void);
+
+static void sigsuspend_event_loop(TimerInfo *ti, sigset_t *oldset);
+static void open_unit_report_pipe(void);
+static void recalibrate_time_unit(TimerInfo *ti);
+static void add_arrived_processes(TimerInfo *ti);
+static void epoll_event_loop(TimerInfo *ti);
+static void set_timer(TimerInfo *ti);
+
+static int64_t timespec_to_ns(struct timespec timespec) {
+    return timespec.tv_sec * BILLION + timespec.tv_nsec;
+}
 
-static void arrival_queue_init(void);
-static int timeunits_until_next_arrival(void);
-static ProcessInfo *get_arrived_process(void);
-static bool arrival_queue_empty(void);
+static struct timespec ns_to_timespec(int64_t ns) {
+    struct timespec timespec = {ns / BILLION, ns % BILLION};
+    return timespec;
+}
 
-static struct timespec *min_timespecp(struct timespec *lhs, struct timespec *rhs) {
-    struct timespec diff = timespec_subtract(*lhs, *rhs);
-    if (diff.tv_sec < 0 || diff.tv_nsec < 0){
-        return lhs;
-    }
-    else {
-        return rhs;
-    }
+static double units_since_epoch(TimerInfo *ti, struct timespec now) {
+    return ti->epoch_units + (double) timespec_to_ns(timespec_subtract(now, ti->epoch)) / timespec_to_ns(ti->time_unit);
 }
 
-static void init_arrival_remaining(TimerInfo *ti) {
-    ti->arrival_remaining = timespec_multiply(ti->time_unit, timeunits_until_next_arrival());
-    if(timeunits_until_next_arrival() == 0){
-        // The first signal may arrive immediately, in which case someone needs to send a signal.
-        raise(SIGALRM);
-    }
+static struct timespec deadline_since_epoch(TimerInfo *ti, int time_units) {
+    double offset_ns = (time_units - ti->epoch_units) * timespec_to_ns(ti->time_unit);
+    return timespec_add(ti->epoch, ns_to_timespec((int64_t) offset_ns));
 }
 
-static void init_timeslice_remaining(TimerInfo *ti) {
-    if(current_strategy != RR) {
-        return;
+/* The deadline of the next event, which is time_units_since_epoch after the epoch,
+ * or time_units_from_base after base, when the previous event of its kind was handled. */
+static struct timespec next_deadline(TimerInfo *ti, int time_units_since_epoch, struct timespec base, int time_units_from_base) {
+    if (absolute_timers) {
+        return deadline_since_epoch(ti, time_units_since_epoch);
     }
-    ti->timeslice_remaining = timespec_multiply(ti->time_unit, RR_TIMES_OF_UNIT);
+    return timespec_add(base, timespec_multiply(ti->time_unit, time_units_from_base));
 }
 
-static EventType get_expire_reason(TimerInfo *ti) {
-    if(current_strategy != RR){
-        return PROCESS_ARRIVAL;
-    }
-    if(arrival_queue_empty()){
-        return TIMESLICE_OVER;
+static void schedule_next_arrival(TimerInfo *ti) {
+    if (arrival_queue_empty() || !arrival_queue_ready()) {
+        return; // handle_input() schedules it once it has been read.
     }
-    struct timespec *min = 
-        min_timespecp(&ti->arrival_remaining, &ti->timeslice_remaining);
-    if (min == &ti->arrival_remaining){
-        return PROCESS_ARRIVAL;
+    timer_queue_add(&ti->queue,
+            next_deadline(ti, next_arrival()->arrival_time, ti->arrival_base, timeunits_until_next_arrival()), PROCESS_ARRIVAL);
+    ti->arrival_queued = true;
+}
+
+/* Takes what the reader thread of --stream has read, which may tell the next arrival. */
+static void handle_input(TimerInfo *ti) {
+    if (arrival_input_fd() == -1) {
+        return;
     }
-    else {
-        return TIMESLICE_OVER;
+    arrival_queue_poll();
+    if (!ti->arrival_queued) {
+        schedule_next_arrival(ti);
+        set_timer(ti);
     }
 }
 
-static void subtract_time_passed(TimerInfo *ti) {
-    if (current_strategy == RR && !arrival_queue_empty()){
-        /* This condition determines whether we are simulating one timer with
-         * two timespecs. 
-         * If the timer expired, than time specified by the lesser of the two timespecs in ti 
-         * has passed.  As we are simulating two timers with only one timer, we have to subtract
-         * the larger timespec with the lesser of the timespecs.
-         */
-        struct timespec *min = 
-            min_timespecp(&ti->arrival_remaining, &ti->timeslice_remaining);
-        if (min == &ti->arrival_remaining){
-            ti->timeslice_remaining = timespec_subtract(ti->timeslice_remaining, *min);
-            min->tv_sec = min->tv_nsec = 0;
-        }
-	else {
-            ti->arrival_remaining = timespec_subtract(ti->arrival_remaining, *min);
-            min->tv_sec = min->tv_nsec = 0;
-        }
+static void schedule_next_timeslice(TimerInfo *ti) {
+    int length = timeslice_length();
+    if (length == 0) {
+        return;
     }
+    ti->timeslice_end += length;
+    timer_queue_add(&ti->queue, next_deadline(ti, ti->timeslice_end, ti->timeslice_base, length), TIMESLICE_OVER);
 }
 
+/* Arms the kernel timer with the earliest deadline in the queue. */
 static void set_timer(TimerInfo *ti) {
     struct itimerspec its;
     its.it_interval.tv_sec = its.it_interval.tv_nsec = 0;
-    if (current_strategy != RR){
-        its.it_value = ti->arrival_remaining;
-    }
-    else if (arrival_queue_empty()){
-        its.it_value = ti->timeslice_remaining;
-    }
-    else { 
-        // To simulate two timers with only one timer, the timer should
-        // send an alarm when the lesser of the timespec has passed.
-        struct timespec *min = 
-            min_timespecp(&ti->arrival_remaining, &ti->timeslice_remaining);
-        its.it_value = *min;
-    } 
-    int err = timer_settime(ti->timer_id, 0, &its, NULL);
+    if (timer_queue_empty(&ti->queue)) {
+        its.it_value.tv_sec = its.it_value.tv_nsec = 0; // disarm the timer
+    } else {
+        its.it_value = timer_queue_next_deadline(&ti->queue);
+    }
+    int err;
+    if (event_loop == EPOLL_LOOP) {
+        err = timerfd_settime(ti->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+    } else {
+        err = timer_settime(ti->timer_id, TIMER_ABSTIME, &its, NULL);
+    }
     if(err == -1) {
         perror("timer_settime error!!!");
         scheduler_exit(err);
     }
 }
 
-static void create_timer_and_init_timespec(TimerInfo *ti) {
+static void create_timer(TimerInfo *ti) {
     // Create the timer
     int err;
-    if((err = timer_create(CLOCKID, NULL, &ti->timer_id)) == -1) {
+    if (event_loop == EPOLL_LOOP) {
+        if ((ti->timer_fd = timerfd_create(CLOCKID, TFD_NONBLOCK | TFD_CLOEXEC)) == -1) {
+            perror("timerfd_create error!!!");
+            scheduler_exit(1);
+        }
+    } else if((err = timer_create(CLOCKID, NULL, &ti->timer_id)) == -1) {
         perror("timer_create error!!!");
         scheduler_exit(err);
     }
 
-    // Init arrival_remaining and timeslice_remaining
-    init_arrival_remaining(ti);
-    init_timeslice_remaining(ti);
+    // Queue the first arrival and the end of the first time slice
+    timer_queue_init(&ti->queue);
+    ti->timeslice_end = 0;
+    ti->arrival_queued = false;
+    ti->arrival_base = ti->timeslice_base = ti->epoch;
+    schedule_next_timeslice(ti);
+    if (arrival_input_fd() != -1) {
+        handle_input(ti); // Sets the timer
+    } else {
+        schedule_next_arrival(ti);
+        set_timer(ti);
+    }
+}
+
+/* Online recalibration.
+ * Each child measures the CPU time it spends on its time units and reports it when it terminates.
+ * The time unit used for the following arrivals and time slices is moved toward that measurement,
+ * by RECALIBRATION_GAIN of the error but never by more than RECALIBRATION_MAX_STEP_PERCENT at once,
+ * so that a single noisy process can't throw the schedule off. */
+
+/* The pipe carries a UnitReport from every child: its CPU time for --recalibrate and how long
+ * after its arrival it started for --stats. */
+static void open_unit_report_pipe(void) {
+    if (pipe(unit_report_fd) == -1) {
+        perror("Can't create the pipe of the unit reports!");
+        scheduler_exit(1);
+    }
+    fcntl(unit_report_fd[0], F_SETFL, O_NONBLOCK);
+}
 
-    // Set the timer
+static void recalibrate_time_unit(TimerInfo *ti) {
+    if (unit_report_fd[0] == -1) {
+        return;
+    }
+    UnitReport report;
+    while (read(unit_report_fd[0], &report, sizeof(report)) == sizeof(report)) {
+        if (print_stats) {
+            // Not part of recalibration: the report also tells when the child started, for --stats.
+            record_latency_ns(&start_latency, report.start_latency_ns);
+        }
+        if (!recalibrate || report.time_needed < RECALIBRATION_MIN_UNITS) {
+            continue;
+        }
+        int64_t unit_ns = timespec_to_ns(ti->time_unit);
+        int64_t step_ns = (int64_t) ((report.cpu_ns / report.time_needed - unit_ns) * RECALIBRATION_GAIN);
+        int64_t max_step_ns = unit_ns * RECALIBRATION_MAX_STEP_PERCENT / 100;
+        if (step_ns > max_step_ns) {
+            step_ns = max_step_ns;
+        } else if (step_ns < -max_step_ns) {
+            step_ns = -max_step_ns;
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCKID, &now);
+        ti->epoch_units = units_since_epoch(ti, now);
+        ti->epoch = now;
+        ti->time_unit = ns_to_timespec(unit_ns + step_ns);
+        recalibration_count++;
+    }
+}
+
+/* Handles every timer that has expired. Timers expiring at the same time are handled together:
+ * the end of a time slice first, then arrivals, the same order as the simulator. */
+static void handle_expired_timers(TimerInfo *ti) {
+    struct timespec now;
+    clock_gettime(CLOCKID, &now);
+    bool timeslice_ended = false, arrived = false;
+    TimerEntry expired;
+    while (timer_queue_pop_expired(&ti->queue, now, &expired)) {
+        if (expired.type == TIMESLICE_OVER) {
+            timeslice_ended = true;
+        } else {
+            arrived = true;
+            ti->arrival_queued = false;
+        }
+    }
+    if (timeslice_ended) {
+        ti->timeslice_base = now;
+        record_latency(&timeslice_lateness, deadline_since_epoch(ti, ti->timeslice_end));
+        timeslice_over(ti->timeslice_end);
+        schedule_next_timeslice(ti);
+    }
+    if (arrived) {
+        ti->arrival_base = now;
+        record_latency(&arrival_lateness, deadline_since_epoch(ti, next_arrival()->arrival_time));
+        add_arrived_processes(ti);
+        schedule_next_arrival(ti);
+    }
     set_timer(ti);
 }
 
-static void assert_nonnegetive_remaining(struct timespec remaining) {
-    assert(remaining.tv_sec >= 0 && remaining.tv_nsec >= 0);
+static int str_to_switch_backend(const char *name) {
+    if (!strcmp(name, "prio")) return PRIORITY_SWITCH;
+    if (!strcmp(name, "signal")) return SIGNAL_SWITCH;
+    if (!strcmp(name, "cgroup")) return CGROUP_SWITCH;
+    return -1;
 }
 
-static bool timspec_is_zero(struct timespec remaining) {
-    if(remaining.tv_sec == 0 && remaining.tv_nsec == 0)
-        return true;
-    else
-        return false;
+/* A comma-separated list of quanta in time units, one per level from the highest. */
+static bool parse_mlfq_quanta(const char *list) {
+    int levels = 0;
+    while (levels < MLFQ_MAX_LEVELS) {
+        char *end;
+        long quantum = strtol(list, &end, 10);
+        if (end == list || quantum <= 0 || quantum > INT_MAX || (*end != ',' && *end != '\0')) {
+            return false;
+        }
+        mlfq_quanta[levels++] = quantum;
+        if (*end == '\0') {
+            mlfq_levels = levels;
+            return true;
+        }
+        list = end + 1;
+    }
+    return false;
 }
 
-static void update_arrival_remaining(TimerInfo *ti, int time_units) {
-    assert_nonnegetive_remaining(ti->arrival_remaining);
-    ti->arrival_remaining = timespec_multiply(ti->time_unit, time_units);
+static void parse_arguments(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--simulate")) {
+            simulation_mode = true;
+        } else if (!strcmp(argv[i], "--pool") && i + 1 < argc) {
+            worker_pool_size = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--stats")) {
+            print_stats = true;
+        } else if (!strcmp(argv[i], "--calibration-cache") && i + 1 < argc) {
+            i++;
+            calibration_cache_path = strcmp(argv[i], "none") ? argv[i] : NULL;
+        } else if (!strcmp(argv[i], "--cpus") && i + 1 < argc && atoi(argv[i+1]) > 0) {
+            requested_cpus = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--switch") && i + 1 < argc && str_to_switch_backend(argv[i+1]) >= 0) {
+            requested_switch = str_to_switch_backend(argv[++i]);
+        } else if (!strcmp(argv[i], "--mlfq") && i + 1 < argc && parse_mlfq_quanta(argv[i+1])) {
+            i++;
+        } else if (!strcmp(argv[i], "--mlfq-boost") && i + 1 < argc && atoi(argv[i+1]) > 0) {
+            mlfq_boost_period = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--edf-admission") && i + 1 < argc && !strcmp(argv[i+1], "flag")) {
+            edf_reject = false;
+            i++;
+        } else if (!strcmp(argv[i], "--edf-admission") && i + 1 < argc && !strcmp(argv[i+1], "reject")) {
+            edf_reject = true;
+            i++;
+        } else if (!strcmp(argv[i], "--cfs-granularity") && i + 1 < argc && atoi(argv[i+1]) > 0) {
+            cfs_granularity = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--quantum") && i + 1 < argc && !strcmp(argv[i+1], "adaptive")) {
+            rr_adaptive = true;
+            i++;
+        } else if (!strcmp(argv[i], "--quantum") && i + 1 < argc && atoi(argv[i+1]) > 0) {
+            rr_quantum = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--aging") && i + 1 < argc && atoi(argv[i+1]) > 0) {
+            aging_rate = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--predict") && i + 1 < argc) {
+            predict_path = argv[++i];
+        } else if (!strcmp(argv[i], "--plugin-dir") && i + 1 < argc) {
+            plugin_dir = argv[++i];
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            lottery_seed = strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--convert") && i + 1 < argc && !strcmp(argv[i+1], "text")) {
+            convert = true;
+            convert_format = TEXT_WORKLOAD;
+            i++;
+        } else if (!strcmp(argv[i], "--convert") && i + 1 < argc && !strcmp(argv[i+1], "binary")) {
+            convert = true;
+            convert_format = BINARY_WORKLOAD;
+            i++;
+        } else if (!strcmp(argv[i], "--stream")) {
+            stream = true;
+        } else if (!strcmp(argv[i], "--recalibrate")) {
+            recalibrate = true;
+        } else if (!strcmp(argv[i], "--abstime")) {
+            absolute_timers = true;
+        } else if (!strcmp(argv[i], "--event-loop") && i + 1 < argc && !strcmp(argv[i+1], "epoll")) {
+            event_loop = EPOLL_LOOP;
+            i++;
+        } else if (!strcmp(argv[i], "--event-loop") && i + 1 < argc && !strcmp(argv[i+1], "sigsuspend")) {
+            event_loop = SIGSUSPEND_LOOP;
+            i++;
+        } else {
+            fprintf(stderr, "Usage: %s [--simulate] [--cpus N] [--switch prio|signal|cgroup] [--pool N] [--stats]\n"
+                    "       [--event-loop sigsuspend|epoll] [--abstime] [--recalibrate] [--calibration-cache PATH|none]\n"
+                    "       [--mlfq QUANTUM,QUANTUM,...] [--mlfq-boost PERIOD] [--edf-admission flag|reject]\n"
+                    "       [--cfs-granularity UNITS] [--seed N] [--aging RATE]\n"
+                    "       [--predict PATH] [--plugin-dir DIR] [--quantum N|adaptive] [--stream] < input\n"
+                    "       %s --convert text|binary < input > converted\n",
+                    argv[0], argv[0]);
+            exit(1);
+        }
+    }
 }
 
-static void update_timeslice_remaining(TimerInfo *ti) {
-    if(current_strategy != RR) {
+/* The waiting time of a process is the time from its arrival to its termination that it didn't run.
+ * It is printed for every process, then the mean and the maximum over all of them. */
+static long waiting_total, waiting_max;
+static int waiting_count;
+static char *waiting_max_name; // A copy, as the process may be freed with --stream
+
+static void account_waiting_time(ProcessInfo *p) {
+    long waited = p->finish_time - p->arrival_time - p->time_needed;
+    fprintf(stderr, "%s: waited %ld units\n", p->name, waited);
+    waiting_total += waited;
+    if (waiting_count++ == 0 || waited > waiting_max) {
+        waiting_max = waited;
+        free(waiting_max_name);
+        waiting_max_name = strdup(p->name);
+    }
+}
+
+static void print_waiting_times(void) {
+    if (waiting_count == 0) {
         return;
     }
-    assert_nonnegetive_remaining(ti->timeslice_remaining);
-    ti->timeslice_remaining = timespec_multiply(ti->time_unit, RR_TIMES_OF_UNIT);
+    fprintf(stderr, "waiting time: mean %.1f units, max %ld units (%s)\n", (double) waiting_total / waiting_count,
+            waiting_max, waiting_max_name);
 }
 
-int main(void) {
-    set_parent_priority();
-    char strat[PROCESS_NAME_MAX];
-    scanf("%s", strat);
-    current_strategy = str_to_strategy(strat);
+/* Without --stream, every process is reported after the run; with it, retire_process() reports
+ * each one as it terminates. */
+static void report_processes(void (*report)(ProcessInfo *)) {
+    for (int i = 0; !stream && i < num_process; i++) {
+        report(&all_process_info[i]);
+    }
+}
 
-    read_process_info();
-    arrival_queue_init();
+void retire_process(ProcessInfo *p) {
+    if (!stream) {
+        return;
+    }
+    if (simulation_mode) {
+        printf("%s %ld %ld\n", p->name, p->start_time, p->finish_time);
+    }
+    if (print_stats) {
+        account_waiting_time(p);
+    }
+    if (current_strategy == EDF) {
+        edf_report_process(p);
+    }
+    release_process(p);
+}
+
+static void print_process(ProcessInfo *p) {
+    if (simulation_mode) {
+        printf("%s %ld %ld\n", p->name, p->start_time, p->finish_time);
+    } else {
+        printf("%s %d\n", p->name, p->pid);
+    }
+}
+
+/* After the run, like the output of the processes */
+static void print_stats_and_reports(void) {
+    arrival_queue_report_late();
+    if (print_stats) {
+        report_processes(account_waiting_time);
+        print_waiting_times();
+        predict_print_stats();
+    }
+    if (current_strategy == EDF) {
+        report_processes(edf_report_process);
+        edf_print_report();
+    }
+    if (predict_path != NULL) {
+        predict_store(predict_path);
+    }
+}
+
+static void simulate(void) {
+    set_strategy(current_strategy, num_process);
+    run_simulation();
+    report_processes(print_process);
+    if (print_stats) {
+        cpus_print_stats();
+        sim_print_stats();
+    }
+    print_stats_and_reports();
+}
+
+int main(int argc, char *argv[]) {
+    calibration_cache_path = calibration_cache_default();
+    parse_arguments(argc, argv);
+    stream = stream && !convert; // Converting needs all of the input.
+    workload_open(stream);
+    char *policy = workload_policy();
+    current_strategy = str_to_strategy(policy);
+    if (stream) {
+        num_process = arrival_queue_stream();
+    } else {
+        all_process_info = workload_processes(&num_process);
+        workload_close();
+        if (convert) {
+            workload_write(stdout, policy, all_process_info, num_process, convert_format);
+            return 0;
+        }
+        arrival_queue_init(all_process_info, num_process); // Sorts them by arrival time
+    }
+    if (predict_path != NULL && (current_strategy == SJF || current_strategy == PSJF)) {
+        predict_load(predict_path);
+    }
+    cpus_init(requested_cpus > 0 ? requested_cpus : 1, requested_cpus > 0);
+    if (simulation_mode) {
+        if (stream) {
+            arrival_queue_start(false);
+        }
+        simulate();
+        return 0;
+    }
+
+    set_parent_priority();
+    if (stream) {
+        arrival_queue_start(true); // Its thread takes the priority just set.
+    }
+    switch_init(requested_switch);
     set_strategy(current_strategy, num_process); 
 
     /* Signal handling */
     sigset_t oldset = block_some_signals();
+
+    if (recalibrate || print_stats) {
+        open_unit_report_pipe();
+    }
+
+    /* Park the workers before calibrating, so that forking doesn't skew the measurement. */
+    pool_init(worker_pool_size);
+    pool_refill(arrivals_left());
+
+    TimerInfo timer_info;
+    timer_info.time_unit = calibrate_time_unit();
+    measured_time_unit_ns = timespec_to_ns(timer_info.time_unit);
+    clock_gettime(CLOCKID, &timer_info.epoch);
+    timer_info.epoch_units = 0;
+    if (event_loop == EPOLL_LOOP) {
+        epoll_event_loop(&timer_info);
+    } else {
+        sigsuspend_event_loop(&timer_info, &oldset);
+    }
+    pool_shutdown();
+    switch_shutdown();
+    report_processes(print_process);
+    if (print_stats) {
+        fprintf(stderr, "time unit: %ld ns (%s)\n", (long) measured_time_unit_ns,
+                time_unit_cached ? "cached" : "measured");
+        if (recalibrate) {
+            int64_t corrected_ns = timespec_to_ns(timer_info.time_unit);
+            fprintf(stderr, "time unit recalibrated from %ld ns to %ld ns (%+.3f%%) with %d terminated processes\n",
+                    (long) measured_time_unit_ns, (long) corrected_ns,
+                    100.0 * (corrected_ns - measured_time_unit_ns) / measured_time_unit_ns, recalibration_count);
+        }
+        print_latency("arrival-to-runnable latency", &arrival_latency);
+        print_latency("arrival-to-start latency", &start_latency);
+        fprintf(stderr, "%d arrivals were handed to the worker pool\n", pool_hit_count);
+        print_latency("arrival timer lateness", &arrival_lateness);
+        print_latency("time slice timer lateness", &timeslice_lateness);
+        cpus_print_stats();
+    }
+    print_stats_and_reports();
+}
+
+/* Adds every process that arrives now. */
+static void add_arrived_processes(TimerInfo *ti) {
+    ProcessInfo *p = get_arrived_process();
+    add_process(p, deadline_since_epoch(ti, p->arrival_time));
+    while(!arrival_queue_empty() && arrival_queue_ready() && timeunits_until_next_arrival() == 0) {
+        p = get_arrived_process();
+        add_process(p, deadline_since_epoch(ti, p->arrival_time));
+    }
+}
+
+static void record_finish_time(TimerInfo *ti, ProcessInfo *p) {
+    struct timespec now;
+    clock_gettime(CLOCKID, &now);
+    p->finish_time = (long) (units_since_epoch(ti, now) + 0.5);
+}
+
+static void sigsuspend_event_loop(TimerInfo *ti, sigset_t *oldset) {
+    pid_table_init(&process_of_pid);
     costumize_signal_handlers();
+    if (arrival_input_fd() != -1) {
+        // Sends SIGIO when the reader thread of --stream has read processes.
+        fcntl(arrival_input_fd(), F_SETOWN, getpid());
+        fcntl(arrival_input_fd(), F_SETFL, O_NONBLOCK | O_ASYNC);
+    }
 
     /* Create the timer */
-    TimerInfo timer_info;
-    timer_info.time_unit = measure_time_unit();
-    create_timer_and_init_timespec(&timer_info);
+    create_timer(ti);
 
     while (true){
-        sigsuspend(&oldset);
+        sigsuspend(oldset);
+        handle_input(ti);
         if(event_type == TIMER_EXPIRED) {
-            event_type = get_expire_reason(&timer_info);
-            subtract_time_passed(&timer_info);
-            if(event_type == TIMESLICE_OVER) {
-                timeslice_over();
-                update_timeslice_remaining(&timer_info);
-            }
-	    else if(event_type == PROCESS_ARRIVAL) {
-                add_process(get_arrived_process());
-                int arrival_time = 0;
-                while(!arrival_queue_empty() && (arrival_time = timeunits_until_next_arrival()) == 0) {
-                    add_process(get_arrived_process());
-                }
-                update_arrival_remaining(&timer_info, arrival_time);
-            }
-            set_timer(&timer_info);
+            handle_expired_timers(ti);
         } 
 	else if(event_type == CHILD_TERMINATED) {
-            wait(NULL);
-            remove_current_process();
+            // Children on different CPUs may terminate together, and their SIGCHLDs are merged.
+            pid_t pid;
+            while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+                switch_detach(pid);
+                ProcessInfo *p = (ProcessInfo *) pid_table_remove(&process_of_pid, pid);
+                if (p == NULL) {
+                    fprintf(stderr, "Reaped pid %d, which isn't a scheduled process\n", pid);
+                    continue;
+                }
+                record_finish_time(ti, p);
+                remove_current_process(p->cpu);
+                retire_process(p);
+                recalibrate_time_unit(ti);
+            }
+        }
+        if (print_stats) {
+            struct timespec now;
+            clock_gettime(CLOCKID, &now);
+            cpus_account(units_since_epoch(ti, now));
         }
         if (arrival_queue_empty() && scheduler_empty()){
             break;
         } 
+	else if (scheduler_empty()) {
+            pool_refill(arrivals_left()); // Nothing else to do until the next arrival.
+        }
 	else {
             context_switch();
         }
     }
-    for(int i = 0; i < num_process; i++){
-        printf("%s %d\n", all_process_info[i].name, all_process_info[i].pid);
+}
+
+/* The epoll event loop.
+ * The timer queue is armed on a timerfd, terminated children are pidfds and SIGINT/SIGTERM
+ * come through a signalfd. Every event that is ready is handled before the next context switch:
+ * terminated children first, then the expired timers. Unlike SIGCHLD, one pidfd per child
+ * can't be coalesced with another one.
+ */
+
+static uint64_t read_timerfd(int fd) {
+    uint64_t expirations = 0;
+    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations) && errno != EAGAIN) {
+        perror("Can't read a timerfd!");
+        scheduler_exit(1);
     }
+    return expirations;
 }
 
-/* IO fnts */
-static ScheduleStrategy str_to_strategy(char strat[]) {
-    if(!strcmp(strat, "RR")) return RR;
-    if(!strcmp(strat, "FIFO")) return FIFO;
-    if(!strcmp(strat, "SJF")) return SJF;
-    if(!strcmp(strat, "PSJF")) return PSJF;
-    assert(0);
+static void epoll_watch(int fd, uint64_t data) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = data;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        perror("epoll_ctl error!!!");
+        scheduler_exit(1);
+    }
 }
 
-static void read_single_entry(ProcessInfo *p) {
-    char *process_name = (char *)malloc(sizeof(char) * PROCESS_NAME_MAX);
-    scanf("%s", process_name);
-    p->name = process_name;
-    scanf("%d%d", &p->arrival_time, &p->time_needed);
-    p->remaining_time = p->time_needed;
-    p->status = NOT_STARTED;
-    p->pid = 0;
+static void watch_child(ProcessInfo *p) {
+    int fd = syscall(SYS_pidfd_open, p->pid, 0);
+    if (fd == -1) {
+        perror("pidfd_open error (Linux 5.3 or later is required by the epoll event loop)");
+        scheduler_exit(1);
+    }
+    if (fd >= child_of_pidfd_size) {
+        child_of_pidfd_size = fd * 2 + 1;
+        child_of_pidfd = (ProcessInfo **) realloc(child_of_pidfd, sizeof(ProcessInfo *) * child_of_pidfd_size);
+    }
+    child_of_pidfd[fd] = p;
+    epoll_watch(fd, (uint64_t) fd << EVENT_SOURCE_BITS | CHILD_SOURCE);
 }
 
+static void reap_child(TimerInfo *ti, int fd) {
+    ProcessInfo *p = child_of_pidfd[fd];
+    waitpid(p->pid, NULL, 0);
+    record_finish_time(ti, p);
+    switch_detach(p->pid);
+    /* Children forked later inherit the pidfd, so closing it alone doesn't remove it from the epoll set,
+     * and the reaped child would keep being reported. */
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    remove_current_process(p->cpu);
+    retire_process(p);
+}
+
+static int create_signalfd(void) {
+    sigset_t control_set;
+    sigemptyset(&control_set);
+    sigaddset(&control_set, SIGINT);
+    sigaddset(&control_set, SIGTERM);
+    sigprocmask(SIG_BLOCK, &control_set, NULL);
+    int fd = signalfd(-1, &control_set, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd == -1) {
+        perror("signalfd error!!!");
+        scheduler_exit(1);
+    }
+    return fd;
+}
+
+static void handle_control_signal(int fd) {
+    struct signalfd_siginfo info;
+    if (read(fd, &info, sizeof(info)) == sizeof(info)) {
+        fprintf(stderr, "Terminated by signal %u\n", info.ssi_signo);
+        signal(SIGINT, SIG_IGN); // scheduler_exit() sends SIGINT to the whole process group.
+        scheduler_exit(1);
+    }
+}
+
+static void epoll_event_loop(TimerInfo *ti) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        perror("epoll_create1 error!!!");
+        scheduler_exit(1);
+    }
+
+    create_timer(ti);
+    epoll_watch(ti->timer_fd, TIMER_SOURCE);
+    int signal_fd = create_signalfd();
+    epoll_watch(signal_fd, SIGNAL_SOURCE);
+    if (arrival_input_fd() != -1) {
+        epoll_watch(arrival_input_fd(), INPUT_SOURCE);
+    }
+
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+    while (true) {
+        int n = epoll_wait(epoll_fd, events, EPOLL_MAX_EVENTS, -1);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait error!!!");
+            scheduler_exit(1);
+        }
+        bool timer_expired = false;
+        for (int i = 0; i < n; i++) {
+            uint64_t data = events[i].data.u64;
+            switch ((EventSource) (data & ((1 << EVENT_SOURCE_BITS) - 1))) {
+                case SIGNAL_SOURCE:
+                    handle_control_signal(signal_fd);
+                    break;
+                case CHILD_SOURCE:
+                    reap_child(ti, data >> EVENT_SOURCE_BITS);
+                    recalibrate_time_unit(ti);
+                    break;
+                case TIMER_SOURCE:
+                    timer_expired = read_timerfd(ti->timer_fd) > 0;
+                    break;
+                case INPUT_SOURCE:
+                    handle_input(ti);
+                    break;
+            }
+        }
+        if (timer_expired) {
+            handle_expired_timers(ti);
+        }
+        if (print_stats) {
+            struct timespec now;
+            clock_gettime(CLOCKID, &now);
+            cpus_account(units_since_epoch(ti, now));
+        }
+
+        if (arrival_queue_empty() && scheduler_empty()) {
+            break;
+        } else if (scheduler_empty()) {
+            pool_refill(arrivals_left());
+        } else {
+            context_switch();
+        }
+    }
+    close(epoll_fd);
+}
+
+/* IO fnts */
+static ScheduleStrategy str_to_strategy(char strat[]) {
+    for (int s = 0; s < PLUGIN; s++) {
+        if (!strcmp(strat, builtin_policies[s]->name)) {
+            return s;
+        }
+    }
+    if (!convert) { // Converting its input doesn't need the plugin.
+        plugin_ops = plugin_load(strat);
+    }
+    return PLUGIN;
+}
 
 /* Block some signals */
 static sigset_t block_some_signals(void) {
@@ -401,6 +988,7 @@ static sigset_t block_some_signals(void) {
     sigemptyset(&block_set);
     sigaddset(&block_set, SIGCHLD);
     sigaddset(&block_set, SIGALRM);
+    sigaddset(&block_set, SIGIO);
     sigprocmask(SIG_BLOCK, &block_set, &oldset);
     return oldset;
 }
@@ -415,31 +1003,23 @@ void sys_log_process_end(ProcessTimeRecord *p) {
     syscall(336, p->pid, &p->start_time);
 }
 
-static void read_process_info(void) {
-    scanf("%d", &num_process);
-
-    all_process_info =  (ProcessInfo *) malloc(num_process * sizeof(ProcessInfo));
-    for(int i = 0; i < num_process; i++) {
-	    read_single_entry(&all_process_info[i]);
-    }
-}
-
-
-extern inline void set_priority(pid_t pid, int priority);
 /* For controlling kernel scheduling */
-static void set_my_priority(int priority) {
-    set_priority(getpid(), priority);
-}
-
+/* With SCHED_RESET_ON_FORK, a child starts with the default policy instead of the parent's
+ * priority, so it can't delay the parent before set_child_priority() or run ahead of the
+ * process that should. */
 static void set_parent_priority(void) {
-    int priority = sched_get_priority_max(SCHED_FIFO);
-    set_my_priority(priority);
+    struct sched_param kernel_sched_param;
+    kernel_sched_param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &kernel_sched_param) != 0) {
+        perror("Can't set scheduler on the parent!");
+        scheduler_exit(1);
+    }
 }
 
-static void set_child_priority(void) {
+static void set_child_priority(pid_t pid) {
     int priority = sched_get_priority_max(SCHED_FIFO);
     priority -= 1;
-    set_my_priority(priority);
+    set_priority(pid, priority);
 }
 
 static bool parent_is_terminated(void) {
@@ -473,47 +1053,74 @@ static struct timespec timespec_subtract(struct timespec lhs, struct timespec rh
     return lhs;
 }
 
-static struct timespec measure_time_unit(void) {
+static struct timespec timespec_add(struct timespec lhs, struct timespec rhs) {
+    lhs.tv_sec += rhs.tv_sec;
+    lhs.tv_nsec += rhs.tv_nsec;
+    if (lhs.tv_nsec >= BILLION){
+        lhs.tv_sec += 1;
+        lhs.tv_nsec -= BILLION;
+    }
+    return lhs;
+}
+
+static struct timespec measure_time_unit(int repeat) {
     struct timespec begin, end;
     clock_gettime(CLOCKID, &begin);
-    for(int i = 0; i < UNIT_MEASURE_REPEAT; i++){
+    for(int i = 0; i < repeat; i++){
         run_single_unit();
     }
     clock_gettime(CLOCKID, &end);
     struct timespec res = timespec_subtract(end, begin);
-    return timespec_divide(res, UNIT_MEASURE_REPEAT);
+    return timespec_divide(res, repeat);
 }
 
-static int processinfo_ptr_cmp(const void * lhs, const void * rhs) {
-    const ProcessInfo * const * lhs_p = lhs;
-    const ProcessInfo * const * rhs_p = rhs;
-    return  (**lhs_p).arrival_time - (**rhs_p).arrival_time;
+/* Uses the cached time unit if a quick measurement agrees with it,
+ * and otherwise measures the time unit from scratch and caches it. */
+static struct timespec calibrate_time_unit(void) {
+    int64_t cached_ns;
+    if (calibration_cache_path != NULL && calibration_cache_load(calibration_cache_path, &cached_ns)) {
+        struct timespec sample = measure_time_unit(UNIT_CHECK_REPEAT);
+        int64_t drift_ns = sample.tv_sec * BILLION + sample.tv_nsec - cached_ns;
+        if (drift_ns < 0) {
+            drift_ns = -drift_ns;
+        }
+        if (drift_ns * 100 <= cached_ns * CALIBRATION_DRIFT_PERCENT) {
+            time_unit_cached = true;
+            struct timespec time_unit = {cached_ns / BILLION, cached_ns % BILLION};
+            return time_unit;
+        }
+    }
+    struct timespec time_unit = measure_time_unit(UNIT_MEASURE_REPEAT);
+    if (calibration_cache_path != NULL) {
+        calibration_cache_store(calibration_cache_path, time_unit.tv_sec * BILLION + time_unit.tv_nsec);
+    }
+    return time_unit;
 }
 
-static void arrival_queue_init(void)
-{
-    arrival_ptr = all_process_info;
+static void record_latency(LatencyStats *stats, struct timespec begin) {
+    struct timespec end;
+    clock_gettime(CLOCKID, &end);
+    struct timespec latency = timespec_subtract(end, begin);
+    record_latency_ns(stats, latency.tv_sec * BILLION + latency.tv_nsec);
 }
 
-static int timeunits_until_next_arrival(void) {
-    assert(!arrival_queue_empty());
-    if (arrival_ptr == all_process_info){
-        return arrival_ptr->arrival_time;
+static void record_latency_ns(LatencyStats *stats, int64_t latency_ns) {
+    if (latency_ns < 0) {
+        latency_ns = 0;
     }
-    ProcessInfo *prev_process = arrival_ptr - 1;
-    return arrival_ptr->arrival_time - prev_process->arrival_time;
-}
-
-static ProcessInfo *get_arrived_process(void)
-{
-    ProcessInfo *ret = arrival_ptr;
-    arrival_ptr++;
-    return ret;
+    stats->total_ns += latency_ns;
+    if (latency_ns > stats->max_ns) {
+        stats->max_ns = latency_ns;
+    }
+    stats->count++;
 }
 
-static bool arrival_queue_empty(void)
-{
-    return arrival_ptr == all_process_info + num_process;
+static void print_latency(const char *what, LatencyStats *stats) {
+    if (stats->count == 0) {
+        return;
+    }
+    fprintf(stderr, "%s: mean %ld ns, max %ld ns over %d events\n",
+            what, (long) (stats->total_ns / stats->count), (long) stats->max_ns, stats->count);
 }
 
 /* The following functions are for testing */
@@ -632,6 +1239,7 @@ void fork_signal_test(void)
 // for debugging
 void scheduler_exit(int status)
 {
+    switch_release_all();
     kill(0, SIGINT);
     exit(status);
 } 
@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include "scheduler.h"
+
+/* A table from pid to a value, with open addressing.
+ *
+ * The slot of a pid is picked by multiplicative hashing, and a pid whose slot is taken goes to
+ * the next free one. The table doubles when it is half full, and a removed entry moves back the
+ * entries after it that would no longer be found, so there are no tombstones and only the pids
+ * in it take room: the children alive, not every process of the input.
+ */
+
+#define PID_TABLE_INITIAL_CAPACITY 64 // A power of two
+
+static int home_slot(const PidTable *t, pid_t pid) {
+    return (uint32_t) pid * 2654435761u & (t->capacity - 1);
+}
+
+/* The slot of pid, or the free slot where it would go */
+static int find_slot(const PidTable *t, pid_t pid) {
+    int slot = home_slot(t, pid);
+    while (t->entries[slot].pid != 0 && t->entries[slot].pid != pid) {
+        slot = (slot + 1) & (t->capacity - 1);
+    }
+    return slot;
+}
+
+void pid_table_init(PidTable *t) {
+    t->capacity = PID_TABLE_INITIAL_CAPACITY;
+    t->count = 0;
+    t->entries = (PidEntry *) calloc(t->capacity, sizeof(PidEntry));
+}
+
+void *pid_table_find(const PidTable *t, pid_t pid) {
+    return t->entries[find_slot(t, pid)].value;
+}
+
+void pid_table_insert(PidTable *t, pid_t pid, void *value) {
+    if ((t->count + 1) * 2 > t->capacity) {
+        PidEntry *old = t->entries;
+        int old_capacity = t->capacity;
+        t->capacity *= 2;
+        t->entries = (PidEntry *) calloc(t->capacity, sizeof(PidEntry));
+        for (int slot = 0; slot < old_capacity; slot++) {
+            if (old[slot].pid != 0) {
+                t->entries[find_slot(t, old[slot].pid)] = old[slot];
+            }
+        }
+        free(old);
+    }
+    PidEntry *entry = &t->entries[find_slot(t, pid)];
+    if (entry->pid == 0) {
+        t->count++;
+    }
+    entry->pid = pid;
+    entry->value = value;
+}
+
+void *pid_table_remove(PidTable *t, pid_t pid) {
+    int slot = find_slot(t, pid);
+    void *value = t->entries[slot].value;
+    if (t->entries[slot].pid == 0) {
+        return NULL;
+    }
+    t->entries[slot].pid = 0;
+    t->entries[slot].value = NULL;
+    t->count--;
+    for (int next = (slot + 1) & (t->capacity - 1); t->entries[next].pid != 0; next = (next + 1) & (t->capacity - 1)) {
+        int home = home_slot(t, t->entries[next].pid);
+        // Whether home is cyclically outside of (slot, next]
+        if ((next > slot && (home <= slot || home > next)) || (next < slot && home <= slot && home > next)) {
+            t->entries[slot] = t->entries[next];
+            t->entries[next].pid = 0;
+            t->entries[next].value = NULL;
+            slot = next;
+        }
+    }
+    return value;
+}
@@ -0,0 +1,62 @@
+#include <ctype.h>
+#include <dlfcn.h>
+#include <limits.h>
+#include <stdio.h>
+#include "scheduler.h"
+
+/* Policies loaded from shared objects.
+ *
+ * A policy that isn't built in is looked up as plugin_dir/NAME.so, loaded with dlopen(), and its
+ * SchedulerOps is read from the symbol policy_ops. The scheduler is linked with -rdynamic, so a
+ * plugin calls resume_process() and suspend_process() and reads current_cpu and num_cpus like
+ * a built-in policy does. A plugin is never unloaded.
+ *
+ * The scheduler runs as root at the highest SCHED_FIFO priority, and NAME comes from the input,
+ * so plugins are only loaded from the directory given with --plugin-dir, never from the current
+ * one by default, and NAME may only hold letters, digits, '_' and '-', so that it can't name a
+ * file anywhere else.
+ */
+
+const char *plugin_dir = NULL;
+
+static bool valid_plugin_name(const char *name) {
+    if (*name == '\0') {
+        return false;
+    }
+    for (const char *c = name; *c != '\0'; c++) {
+        if (!isalnum((unsigned char) *c) && *c != '_' && *c != '-') {
+            return false;
+        }
+    }
+    return true;
+}
+
+const SchedulerOps *plugin_load(const char *name) {
+    if (plugin_dir == NULL) {
+        fprintf(stderr, "Unknown policy %s: plugins are only loaded with --plugin-dir\n", name);
+        exit(1);
+    }
+    if (!valid_plugin_name(name)) {
+        fprintf(stderr, "Unknown policy %s: a plugin name may only hold letters, digits, '_' and '-'\n", name);
+        exit(1);
+    }
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s.so", plugin_dir, name);
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        fprintf(stderr, "Unknown policy %s: %s\n", name, dlerror());
+        exit(1);
+    }
+    const SchedulerOps *ops = (const SchedulerOps *) dlsym(handle, "policy_ops");
+    if (ops == NULL) {
+        fprintf(stderr, "%s doesn't export policy_ops\n", path);
+        exit(1);
+    }
+    if (ops->set_strategy == NULL || ops->add_process == NULL || ops->remove_current_process == NULL ||
+            ops->context_switch == NULL || ops->scheduler_empty == NULL || ops->queue_length == NULL ||
+            ops->steal_process == NULL || (ops->timeslice_over == NULL) != (ops->timeslice_length == NULL)) {
+        fprintf(stderr, "%s: policy_ops is missing a scheduler function\n", path);
+        exit(1);
+    }
+    return ops;
+}
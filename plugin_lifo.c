@@ -0,0 +1,70 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "scheduler.h"
+
+/* Last in, first out, as an example of a policy loaded from a shared object: `make LIFO.so`,
+ * then an input whose first line is LIFO runs it with `./main --plugin-dir .`.
+ *
+ * The process that arrived last runs next, and runs until it terminates. Everything is static
+ * but policy_ops, so that nothing clashes with the symbols of the scheduler.
+ */
+
+typedef struct RunQueue {
+    ProcessInfo **stack; // Of the waiting processes
+    int count;
+    ProcessInfo *running;
+} RunQueue;
+
+static RunQueue *run_queues; // One per CPU
+
+static void set_strategy_LIFO(int num_process) {
+    run_queues = (RunQueue *) calloc(num_cpus, sizeof(RunQueue));
+    for (int cpu = 0; cpu < num_cpus; cpu++) {
+        run_queues[cpu].stack = (ProcessInfo **) malloc(sizeof(ProcessInfo *) * num_process);
+    }
+}
+
+static void add_process_LIFO(ProcessInfo *p) {
+    RunQueue *rq = &run_queues[current_cpu];
+    rq->stack[rq->count++] = p;
+}
+
+static void remove_current_process_LIFO(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    assert(rq->running != NULL);
+    rq->running = NULL;
+}
+
+static void context_switch_LIFO(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    if (rq->running == NULL && rq->count > 0) {
+        rq->running = rq->stack[--rq->count];
+        resume_process(rq->running->pid);
+    }
+}
+
+static bool scheduler_empty_LIFO(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    return rq->running == NULL && rq->count == 0;
+}
+
+static int queue_length_LIFO(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    return rq->count + (rq->running != NULL);
+}
+
+static ProcessInfo *steal_process_LIFO(void) {
+    RunQueue *rq = &run_queues[current_cpu];
+    return rq->count > 0 ? rq->stack[--rq->count] : NULL;
+}
+
+const SchedulerOps policy_ops = {
+    .name = "LIFO",
+    .set_strategy = set_strategy_LIFO,
+    .add_process = add_process_LIFO,
+    .remove_current_process = remove_current_process_LIFO,
+    .context_switch = context_switch_LIFO,
+    .scheduler_empty = scheduler_empty_LIFO,
+    .queue_length = queue_length_LIFO,
+    .steal_process = steal_process_LIFO,
+};
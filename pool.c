@@ -0,0 +1,114 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "scheduler.h"
+
+/* Pre-forked worker pool.
+ *
+ * Forking a child when a process arrives puts fork(), copy-on-write faults and
+ * sched_setscheduler() on the critical path of the scheduler, once for every process
+ * that arrives at the same time. Instead, workers are forked in advance and parked:
+ * each one is already suspended and blocks on reading its own pipe.
+ * When a process arrives, the scheduler writes the process's run time into the pipe,
+ * and the worker becomes an ordinary child that runs the process and terminates.
+ */
+
+typedef struct Job {
+    int time_needed;
+    int64_t arrival_ns; // When the process was due to arrive
+} Job;
+
+typedef struct Worker {
+    pid_t pid;
+    int job_fd; // Write end of the pipe the worker is parked on.
+} Worker;
+
+/* The parked workers form a circular queue, so that jobs go to workers in the order they were forked.
+ * Like with fork(), a process that arrives later gets a larger pid, which SJF and PSJF use to break ties. */
+static Worker *parked;
+static int parked_head = 0;
+static int parked_count = 0;
+static int pool_size = 0;
+
+static Worker *parked_worker(int i) {
+    return &parked[(parked_head + i) % pool_size];
+}
+
+static void close_parked_fds(void) {
+    for (int i = 0; i < parked_count; i++) {
+        close(parked_worker(i)->job_fd);
+    }
+}
+
+static void worker_main(int job_fd) {
+    Job job;
+    ssize_t res = read(job_fd, &job, sizeof(job));
+    if (res != sizeof(job)) {
+        _exit(0); // The pool has been shut down.
+    }
+    run_child(job.time_needed, job.arrival_ns);
+}
+
+static void fork_a_worker(void) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        perror("Can't create a pipe for the worker pool!");
+        scheduler_exit(1);
+    }
+    pid_t pid = my_fork();
+    if (pid == 0) {
+        close_parked_fds();
+        close(fds[1]);
+        worker_main(fds[0]);
+    }
+    close(fds[0]);
+    suspend_process(pid);
+    Worker *w = parked_worker(parked_count);
+    w->pid = pid;
+    w->job_fd = fds[1];
+    parked_count++;
+}
+
+void pool_init(int size) {
+    pool_size = size;
+    parked = (Worker *) malloc(sizeof(Worker) * (size > 0 ? size : 1));
+}
+
+void pool_refill(int arrivals_left) {
+    // There is no point in parking more workers than the processes yet to arrive.
+    while (parked_count < pool_size && parked_count < arrivals_left) {
+        fork_a_worker();
+    }
+}
+
+pid_t pool_dispatch(int time_needed, int64_t arrival_ns) {
+    if (parked_count == 0) {
+        return 0;
+    }
+    Worker *w = parked_worker(0);
+    parked_head = (parked_head + 1) % pool_size;
+    parked_count--;
+    Job job = {time_needed, arrival_ns};
+    ssize_t res = write(w->job_fd, &job, sizeof(job));
+    if (res != sizeof(job)) {
+        perror("Can't hand a job to a parked worker!");
+        scheduler_exit(1);
+    }
+    close(w->job_fd);
+    return w->pid;
+}
+
+void pool_shutdown(void) {
+    // Closing the pipes wakes the parked workers up, and they exit without running anything.
+    close_parked_fds();
+    for (int i = 0; i < parked_count; i++) {
+        pid_t pid = parked_worker(i)->pid;
+        resume_process(pid); // A stopped or frozen worker can't exit otherwise.
+        waitpid(pid, NULL, 0);
+        switch_detach(pid);
+    }
+    parked_count = 0;
+    pool_size = 0;
+}
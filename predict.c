@@ -0,0 +1,163 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scheduler.h"
+
+/* Run time prediction for SJF and PSJF, enabled by --predict PATH.
+ *
+ * Production jobs don't declare how long they run, so with --predict, SJF and PSJF order the
+ * processes by a prediction instead of time_needed, which is then only used to run the children.
+ * The prediction is per class of jobs, the name of a process without its trailing digits, so
+ * "backup3" and "backup4" share one. It is an exponential average of the times the jobs of the
+ * class needed: estimate = PREDICT_ALPHA * time needed + (1 - PREDICT_ALPHA) * estimate, updated
+ * whenever a job terminates, so a job arriving later in the same run already benefits. A class
+ * never seen starts at the mean estimate of the others.
+ *
+ * The estimates persist in PATH, one "<class> <estimate> <runs>" line per class.
+ */
+
+#define PREDICT_ALPHA 0.5
+#define PREDICT_DEFAULT_ESTIMATE 500 // Time units, before anything has been seen
+#define PREDICT_INITIAL_CAPACITY 64
+#define PREDICT_CLASS_MAX 100
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+typedef struct PredictEntry {
+    char *job_class; // NULL if the entry is free
+    double estimate;
+    long runs;
+} PredictEntry;
+
+static bool enabled = false;
+static PredictEntry *entries; // Open addressing with linear probing
+static int capacity, count;
+static double estimate_sum; // Of every entry, for the classes never seen
+static long error_sum, absolute_sum, needed_sum; // Of the jobs that have terminated, for --stats
+static int terminated_count;
+
+static uint64_t class_hash(const char *job_class, size_t len) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char) job_class[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/* The length of the class of a job name: the name without its trailing digits, unless it is all digits */
+static size_t class_length(const char *name) {
+    size_t len = strlen(name);
+    while (len > 0 && isdigit((unsigned char) name[len - 1])) {
+        len--;
+    }
+    return len > 0 ? len : strlen(name);
+}
+
+static PredictEntry *find_slot(PredictEntry *table, int table_capacity, const char *job_class, size_t len) {
+    int i = class_hash(job_class, len) & (table_capacity - 1);
+    while (table[i].job_class != NULL &&
+            (strlen(table[i].job_class) != len || strncmp(table[i].job_class, job_class, len))) {
+        i = (i + 1) & (table_capacity - 1);
+    }
+    return &table[i];
+}
+
+static void grow(void) {
+    PredictEntry *old = entries;
+    int old_capacity = capacity;
+    capacity = capacity ? capacity * 2 : PREDICT_INITIAL_CAPACITY;
+    entries = (PredictEntry *) calloc(capacity, sizeof(PredictEntry));
+    for (int i = 0; i < old_capacity; i++) {
+        if (old[i].job_class != NULL) {
+            *find_slot(entries, capacity, old[i].job_class, strlen(old[i].job_class)) = old[i];
+        }
+    }
+    free(old);
+}
+
+/* The entry of the class, created with estimate if it doesn't exist */
+static PredictEntry *lookup(const char *job_class, size_t len, double estimate) {
+    if ((count + 1) * 4 > capacity * 3) {
+        grow();
+    }
+    PredictEntry *entry = find_slot(entries, capacity, job_class, len);
+    if (entry->job_class == NULL) {
+        entry->job_class = strndup(job_class, len);
+        entry->estimate = estimate;
+        entry->runs = 0;
+        estimate_sum += estimate;
+        count++;
+    }
+    return entry;
+}
+
+void predict_load(const char *path) {
+    enabled = true;
+    grow();
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return; // Nothing has been predicted yet.
+    }
+    char job_class[PREDICT_CLASS_MAX + 1];
+    double estimate;
+    long runs;
+    while (fscanf(fp, "%100s %lf %ld", job_class, &estimate, &runs) == 3) {
+        if (estimate > 0) {
+            lookup(job_class, strlen(job_class), estimate)->runs = runs;
+        }
+    }
+    fclose(fp);
+}
+
+void predict_store(const char *path) {
+    if (!enabled) {
+        return;
+    }
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        perror("Can't write the run time predictions");
+        return; // Not fatal; the next run starts from the old ones.
+    }
+    for (int i = 0; i < capacity; i++) {
+        if (entries[i].job_class != NULL) {
+            fprintf(fp, "%s %.3f %ld\n", entries[i].job_class, entries[i].estimate, entries[i].runs);
+        }
+    }
+    fclose(fp);
+}
+
+void predict_arrival(ProcessInfo *p) {
+    if (!enabled) {
+        return;
+    }
+    double unseen = count > 0 ? estimate_sum / count : PREDICT_DEFAULT_ESTIMATE;
+    PredictEntry *entry = lookup(p->name, class_length(p->name), unseen);
+    long predicted = (long) (entry->estimate + 0.5);
+    p->prediction_error = (predicted > 0 ? predicted : 1) - p->time_needed;
+}
+
+void predict_terminated(ProcessInfo *p) {
+    if (!enabled) {
+        return;
+    }
+    PredictEntry *entry = lookup(p->name, class_length(p->name), p->time_needed);
+    double estimate = PREDICT_ALPHA * p->time_needed + (1 - PREDICT_ALPHA) * entry->estimate;
+    estimate_sum += estimate - entry->estimate;
+    entry->estimate = estimate;
+    entry->runs++;
+    error_sum += p->prediction_error;
+    absolute_sum += labs(p->prediction_error);
+    needed_sum += p->time_needed;
+    terminated_count++;
+}
+
+void predict_print_stats(void) {
+    if (!enabled || terminated_count == 0) {
+        return;
+    }
+    fprintf(stderr, "prediction: mean error %+.1f units, mean absolute error %.1f units (%.1f%% of the mean time needed), %d classes\n",
+            (double) error_sum / terminated_count, (double) absolute_sum / terminated_count,
+            needed_sum > 0 ? 100.0 * absolute_sum / needed_sum : 0.0, count);
+}
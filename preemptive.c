@@ -0,0 +1,80 @@
+#include "scheduler.h"
+#include <assert.h>
+
+/* The run queue of a preemptive policy whose processes are ordered by a key of the heap:
+ * the remaining time for PSJF.c, the deadline for EDF.c. Every process of a CPU stays in the
+ * heap, and after preemptive_context_switch() its top is the one running. Nothing tells the
+ * scheduler the time, so it is worked out from the arrivals and the terminations.
+ */
+
+void preemptive_init(PreemptiveQueue *q, int expected_size, HeapKey key) {
+    heap_init_key(&q->pq, expected_size, key);
+    q->active_process = NULL;
+    q->last_context_switch_time = q->current_time = 0;
+}
+
+ProcessInfo *preemptive_arrive(PreemptiveQueue *q, ProcessInfo *p) {
+    // A process stolen from another CPU arrived earlier than the time this CPU has reached.
+    if (p->arrival_time > q->current_time) {
+        q->current_time = p->arrival_time;
+    }
+    // Nothing is running if the scheduler is idle.
+    if (q->active_process == NULL || q->current_time <= q->last_context_switch_time) {
+        return NULL;
+    }
+    ProcessInfo *running = q->active_process;
+    assert(running == heap_top(&q->pq));
+    running->remaining_time -= (q->current_time - q->last_context_switch_time);
+    // The time it runs doesn't count as waiting.
+    running->wait_origin += (q->current_time - q->last_context_switch_time);
+    // Deducting its remaining time keeps it on top, so the update doesn't move it; with aging
+    // too, as moving wait_origin raises the key by at most the time deducted.
+    heap_update(&q->pq, running);
+    // Several processes may arrive at once, so the time passed is deducted only once.
+    q->last_context_switch_time = q->current_time;
+    return running;
+}
+
+ProcessInfo *preemptive_terminate(PreemptiveQueue *q) {
+    ProcessInfo *terminated = q->active_process;
+    assert(terminated == heap_top(&q->pq));
+    q->current_time += terminated->remaining_time;
+    q->active_process = NULL;
+    heap_pop(&q->pq);
+    return terminated;
+}
+
+void preemptive_context_switch(PreemptiveQueue *q) {
+    if (!heap_empty(&q->pq) && q->active_process != heap_top(&q->pq)) {
+        if (q->active_process != NULL) {
+            suspend_process(q->active_process->pid);
+        }
+        q->active_process = heap_top(&q->pq);
+        resume_process(q->active_process->pid);
+    }
+    q->last_context_switch_time = q->current_time;
+}
+
+bool preemptive_empty(PreemptiveQueue *q) {
+    return q->active_process == NULL && heap_empty(&q->pq);
+}
+
+ProcessInfo *preemptive_steal(PreemptiveQueue *q) {
+    if (heap_empty(&q->pq)) {
+        return NULL;
+    }
+    if (q->active_process == NULL || q->active_process != heap_top(&q->pq)) {
+        ProcessInfo *stolen = heap_top(&q->pq);
+        heap_pop(&q->pq);
+        return stolen;
+    }
+    if (heap_size(&q->pq) < 2) {
+        return NULL;
+    }
+    // The running process is on top; take the next one and put the running one back.
+    heap_pop(&q->pq);
+    ProcessInfo *stolen = heap_top(&q->pq);
+    heap_pop(&q->pq);
+    heap_insert(&q->pq, q->active_process);
+    return stolen;
+}
@@ -0,0 +1,193 @@
+#include "scheduler.h"
+
+/* A red-black tree of processes ordered by (vruntime, pid), through rb_left, rb_right and
+ * rb_parent of ProcessInfo, for CFS.c and STRIDE.c. The leaves are the sentinel nil of each
+ * tree, which is always black, and whose parent is only meaningful while a node is erased.
+ * The leftmost process is cached, so the next one to run is found in O(1).
+ */
+
+bool rbtree_before(const ProcessInfo *lhs, const ProcessInfo *rhs) {
+    if (lhs->vruntime == rhs->vruntime) {
+        return lhs->pid < rhs->pid;
+    }
+    return lhs->vruntime < rhs->vruntime;
+}
+
+static void replace_child(RbTree *tree, ProcessInfo *parent, ProcessInfo *old, ProcessInfo *new) {
+    if (parent == &tree->nil) {
+        tree->root = new;
+    } else if (parent->rb_left == old) {
+        parent->rb_left = new;
+    } else {
+        parent->rb_right = new;
+    }
+}
+
+static void rotate_left(RbTree *tree, ProcessInfo *x) {
+    ProcessInfo *y = x->rb_right;
+    x->rb_right = y->rb_left;
+    if (y->rb_left != &tree->nil) {
+        y->rb_left->rb_parent = x;
+    }
+    y->rb_parent = x->rb_parent;
+    replace_child(tree, x->rb_parent, x, y);
+    y->rb_left = x;
+    x->rb_parent = y;
+}
+
+static void rotate_right(RbTree *tree, ProcessInfo *x) {
+    ProcessInfo *y = x->rb_left;
+    x->rb_left = y->rb_right;
+    if (y->rb_right != &tree->nil) {
+        y->rb_right->rb_parent = x;
+    }
+    y->rb_parent = x->rb_parent;
+    replace_child(tree, x->rb_parent, x, y);
+    y->rb_right = x;
+    x->rb_parent = y;
+}
+
+void rbtree_insert(RbTree *tree, ProcessInfo *p) {
+    ProcessInfo *parent = &tree->nil;
+    ProcessInfo **link = &tree->root;
+    while (*link != &tree->nil) {
+        parent = *link;
+        link = rbtree_before(p, parent) ? &parent->rb_left : &parent->rb_right;
+    }
+    *link = p;
+    p->rb_parent = parent;
+    p->rb_left = p->rb_right = &tree->nil;
+    p->rb_red = true;
+    if (tree->leftmost == NULL || rbtree_before(p, tree->leftmost)) {
+        tree->leftmost = p;
+    }
+
+    // A red node may have a red parent; move the violation up until it is gone.
+    while (p->rb_parent->rb_red) {
+        ProcessInfo *grandparent = p->rb_parent->rb_parent;
+        bool parentreeis_left = p->rb_parent == grandparent->rb_left;
+        ProcessInfo *uncle = parentreeis_left ? grandparent->rb_right : grandparent->rb_left;
+        if (uncle->rb_red) {
+            p->rb_parent->rb_red = uncle->rb_red = false;
+            grandparent->rb_red = true;
+            p = grandparent;
+            continue;
+        }
+        if (parentreeis_left) {
+            if (p == p->rb_parent->rb_right) {
+                p = p->rb_parent;
+                rotate_left(tree, p);
+            }
+            rotate_right(tree, grandparent);
+        } else {
+            if (p == p->rb_parent->rb_left) {
+                p = p->rb_parent;
+                rotate_right(tree, p);
+            }
+            rotate_left(tree, grandparent);
+        }
+        p->rb_parent->rb_red = false;
+        grandparent->rb_red = true;
+    }
+    tree->root->rb_red = false;
+}
+
+static ProcessInfo *subtree_min(RbTree *tree, ProcessInfo *t) {
+    while (t->rb_left != &tree->nil) {
+        t = t->rb_left;
+    }
+    return t;
+}
+
+void rbtree_erase(RbTree *tree, ProcessInfo *p) {
+    if (tree->leftmost == p) {
+        // It has no left child, so the next one is the least on its right, or its parent.
+        ProcessInfo *next = p->rb_right != &tree->nil ? subtree_min(tree, p->rb_right) : p->rb_parent;
+        tree->leftmost = next != &tree->nil ? next : NULL;
+    }
+
+    // x takes the place of the node that leaves its position in the tree.
+    ProcessInfo *x;
+    bool removed_red = p->rb_red;
+    if (p->rb_left == &tree->nil || p->rb_right == &tree->nil) {
+        x = p->rb_left != &tree->nil ? p->rb_left : p->rb_right;
+        x->rb_parent = p->rb_parent; // Even when x is nil, for the fix-up below
+        replace_child(tree, p->rb_parent, p, x);
+    } else {
+        // The next node takes the place of p, and its right child takes its place.
+        ProcessInfo *next = subtree_min(tree, p->rb_right);
+        removed_red = next->rb_red;
+        x = next->rb_right;
+        if (next->rb_parent == p) {
+            x->rb_parent = next;
+        } else {
+            x->rb_parent = next->rb_parent;
+            replace_child(tree, next->rb_parent, next, x);
+            next->rb_right = p->rb_right;
+            next->rb_right->rb_parent = next;
+        }
+        replace_child(tree, p->rb_parent, p, next);
+        next->rb_parent = p->rb_parent;
+        next->rb_left = p->rb_left;
+        next->rb_left->rb_parent = next;
+        next->rb_red = p->rb_red;
+    }
+    if (removed_red) {
+        return;
+    }
+
+    // The paths through x lack a black node; push the lack up or fix it with rotations.
+    while (x != tree->root && !x->rb_red) {
+        ProcessInfo *parent = x->rb_parent;
+        bool x_is_left = x == parent->rb_left;
+        ProcessInfo *sibling = x_is_left ? parent->rb_right : parent->rb_left;
+        if (sibling->rb_red) {
+            sibling->rb_red = false;
+            parent->rb_red = true;
+            if (x_is_left) {
+                rotate_left(tree, parent);
+            } else {
+                rotate_right(tree, parent);
+            }
+            sibling = x_is_left ? parent->rb_right : parent->rb_left;
+        }
+        ProcessInfo *near = x_is_left ? sibling->rb_left : sibling->rb_right;
+        ProcessInfo *far = x_is_left ? sibling->rb_right : sibling->rb_left;
+        if (!near->rb_red && !far->rb_red) {
+            sibling->rb_red = true;
+            x = parent;
+            continue;
+        }
+        if (!far->rb_red) {
+            near->rb_red = false;
+            sibling->rb_red = true;
+            if (x_is_left) {
+                rotate_right(tree, sibling);
+            } else {
+                rotate_left(tree, sibling);
+            }
+            far = sibling;
+            sibling = near;
+        }
+        sibling->rb_red = parent->rb_red;
+        parent->rb_red = false;
+        far->rb_red = false;
+        if (x_is_left) {
+            rotate_left(tree, parent);
+        } else {
+            rotate_right(tree, parent);
+        }
+        x = tree->root;
+    }
+    x->rb_red = false;
+}
+
+void rbtree_init(RbTree *tree) {
+    tree->nil.rb_red = false;
+    tree->root = &tree->nil;
+    tree->leftmost = NULL;
+}
+
+ProcessInfo *rbtree_first(RbTree *tree) {
+    return tree->leftmost;
+}
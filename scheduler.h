@@ -1,14 +1,21 @@
 #ifndef __SCHEDULER__
 #define __SCHEDULER__
 
+#include <limits.h>
 #include <sched.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 
 #include <signal.h>
 
 #define ITERATION_PER_TIMEUNIT 1000000UL // one unit, one million iterations
+#define RR_TIMES_OF_UNIT 500
+#define MLFQ_MAX_LEVELS 16
+#define NO_DEADLINE INT_MAX
+#define CFS_DEFAULT_WEIGHT 1024 // The weight of nice 0 in Linux
+#define DEFAULT_TICKETS 100 // Of a process in STRIDE and LOTTERY
 
 typedef enum ProcessStatus {    // data structures
     NOT_STARTED, RUNNING, STOPPED
@@ -18,6 +25,10 @@ typedef enum EventType {
     TIMER_EXPIRED, CHILD_TERMINATED, TIMESLICE_OVER, PROCESS_ARRIVAL
 } EventType;
 
+typedef enum EdfAdmission { // What EDF admission control decided for a process
+    NOT_ADMITTED, ADMITTED, OVER_CAPACITY, REJECTED
+} EdfAdmission;
+
 typedef struct ProcessTimeRecord { // For logging
     pid_t pid;
     struct timespec start_time;
@@ -26,62 +37,234 @@ typedef struct ProcessTimeRecord { // For logging
 typedef struct ProcessInfo {
     int arrival_time;
     int time_needed; // Same as execution time in the problem description i.e. time needed to run the process.
-    int remaining_time; // Remaining time for the process; Use in PSJF to determine the process to be run.
+    int remaining_time; // Remaining time for the process; Use in PSJF to determine the process to be run, and by RR for grace extensions.
     pid_t pid;
     ProcessStatus status;
     char *name; // Not an array; please allocate memory before writing.
+    long start_time; // Time unit in which the process first runs. Only filled in by the simulator.
+    long finish_time; // Time unit in which the process terminates. Filled in by the simulator, and by real runs of EDF or with --stats.
+    int cpu; // The CPU whose run queue holds the process, or -1 before it arrives.
+    struct ProcessInfo *rr_next, *rr_prev; // Links of the RR run queue, or of an MLFQ level
+    int mlfq_level; // MLFQ level, 0 being the highest
+    int mlfq_slices; // Time slices run at mlfq_level since it got there
+    int mlfq_generation; // Boosts of its MLFQ run queue when mlfq_level was set; older means level 0
+    int deadline; // Time unit by which it should terminate, from the optional fourth input column, or NO_DEADLINE
+    int edf_deadline; // The deadline EDF schedules it by; NO_DEADLINE if admission control rejected it
+    EdfAdmission admission;
+    struct EdfNode *edf_node; // In the deadline order kept by EDF admission control, or NULL
+    int weight; // CFS weight or STRIDE and LOTTERY tickets, from the optional fourth input column
+    long vruntime; // Time run, scaled by the inverse of weight: the CFS vruntime, or the stride pass
+    struct ProcessInfo *rb_left, *rb_right, *rb_parent; // Links of the CFS red-black tree
+    bool rb_red;
+    int queue_slot; // Its slot in the LOTTERY Fenwick tree or its leaf in the HRRN tournament, or -1
+    int wait_origin; // Its wait counts from then for SJF/PSJF aging; moves with the time it runs
+    int prediction_error; // Predicted minus actual time needed, with --predict; 0 otherwise
+    int heap_index; // Position in the SJF/PSJF heap (or in its radix bucket), or -1 if it isn't in one
+    signed char heap_bucket; // Radix bucket holding it, or -1 if it is in the 4-ary heap
 } ProcessInfo;
 
 typedef enum scheduleStrategy { // for input
-    FIFO, RR, SJF, PSJF
+    FIFO, RR, SJF, PSJF, MLFQ, EDF, CFS, STRIDE, LOTTERY, HRRN,
+    PLUGIN // A policy loaded from a shared object, see plugin.c
 } ScheduleStrategy;
 
+typedef enum SwitchBackend { // How suspend_process() and resume_process() work; set by --switch
+    PRIORITY_SWITCH, SIGNAL_SWITCH, CGROUP_SWITCH
+} SwitchBackend;
+
 /* Global variables */
 extern ScheduleStrategy current_strategy;
+extern bool simulation_mode; // Set by --simulate; no child is forked and time is virtual.
+extern int num_cpus; // Set by --cpus; 1 by default.
+extern int current_cpu; // The run queue the scheduler functions work on. Set by the event dispatchers.
+
+/* Event dispatchers, implemented in main.c.
+ * They forward an event to the scheduler selected by current_strategy, through its
+ * SchedulerOps, on every CPU or on the CPU the event belongs to. */
+void set_strategy(ScheduleStrategy s, int max_process);
+void admit_process(ProcessInfo *);
+void remove_current_process(int cpu); // The process running on cpu has terminated.
+void retire_process(ProcessInfo *p); // After remove_current_process(); with --stream, reports and frees it.
+void timeslice_over(long now); // now: when the time slice ended, in time units
+int timeslice_length(void); // Of the time slices starting from now, in time units, or 0 if the policy doesn't use them
+void context_switch(void);
+bool scheduler_empty(void);
+int queue_length(void); // Of current_cpu
+ProcessInfo *steal_process(void); // From current_cpu
+
+/* Per-CPU run queues, implemented in cpus.c */
+void cpus_init(int n, bool pin);
+int least_loaded_cpu(void);
+void move_process(ProcessInfo *p, int cpu);
+void steal_work(int thief);
+void cpus_account(double now); // Called after every event, with the time in time units.
+void cpus_arrival(ProcessInfo *p); // Counts p in the makespan on one CPU.
+void cpus_print_stats(void);
+
+/* Arrival queue, implemented in arrivals.c.
+ * The processes in the order they arrive, whatever their order in the input: all of them read
+ * beforehand and sorted by arrival_queue_init(), or with --stream, read a window ahead as they
+ * are needed once arrival_queue_start() has been called after arrival_queue_stream(), which
+ * returns how many there are. A streamed process is freed by release_process() once it has been
+ * reported. In the background, a thread reads the input, and the event loop calls
+ * arrival_queue_poll() when arrival_input_fd() is readable; the next arrival may only be looked
+ * at when arrival_queue_ready(). */
+void arrival_queue_init(ProcessInfo *processes, int num_process);
+int arrival_queue_stream(void);
+void arrival_queue_start(bool in_background);
+int arrival_input_fd(void); // -1 unless the input is read in the background
+void arrival_queue_poll(void);
+bool arrival_queue_ready(void);
+void arrival_queue_report_late(void); // Warns how many streamed processes arrived late, if more than one did.
+bool arrival_queue_empty(void);
+int arrivals_left(void);
+ProcessInfo *next_arrival(void); // The process that arrives next, still in the queue
+ProcessInfo *get_arrived_process(void);
+int timeunits_until_next_arrival(void); // From the arrival of the previous one
+void release_process(ProcessInfo *p);
+
+/* Discrete-event simulation, implemented in simulate.c.
+ * run_simulation() drives the same event dispatchers on a virtual clock, over the arrival
+ * queue, and fills in start_time and finish_time of every process. */
+void run_simulation(void);
+void sim_suspend_process(pid_t pid);
+void sim_resume_process(pid_t pid);
+void sim_move_process(pid_t pid, int cpu);
+void sim_print_stats(void); // Context switches and preemptions
+
+/* RR time slice in time units, set by --quantum, which STRIDE and LOTTERY use too.
+ * With --quantum adaptive, RR picks it from the run times of the processes; see RR.c. */
+extern int rr_quantum;
+extern bool rr_adaptive;
+
+/* MLFQ configuration, set by --mlfq and --mlfq-boost, in time units */
+extern int mlfq_levels;
+extern int mlfq_quanta[MLFQ_MAX_LEVELS]; // Of each level
+extern int mlfq_boost_period;
+
+/* EDF admission control, set by --edf-admission; see EDF.c */
+extern bool edf_reject;
+void edf_report_process(ProcessInfo *p); // Prints its lateness, once it has terminated.
+void edf_print_report(void); // Deadline misses and maximum lateness
+
+/* CFS minimum granularity in time units, set by --cfs-granularity */
+extern int cfs_granularity;
 
-/* Scheduler functions: should be implemented by each scheduler */
-/* The scheduler will be informed that an event has happend via a function call. */
-
-/* Each scheduler should maintain a global data structure to record which processes are being managed.
- * For example, an array of (ProcessInfo *),  a linked list of (ProcessInfo *), or a queue of (ProcessInfo *).
- * You should initialize your data structures when set_strategy() is called.*/
-void set_strategy_FIFO(int num_process);
-void set_strategy_RR(int num_process);
-void set_strategy_SJF(int num_process);
-void set_strategy_PSJF(int num_process);
-
-/* A call to add_process() means that a new process has arrived.  Please update your data structure.
- * Its possible that multiple new processes arrive simultaneously, so don't perform a context switch. */
-void add_process_FIFO(ProcessInfo *);
-void add_process_RR(ProcessInfo *);
-void add_process_SJF(ProcessInfo *);
-void add_process_PSJF(ProcessInfo *);
-
-/* A call to remove_process() signals that the current process has ended.
- * Please remove current process from your data structure, but don't perform a context switch. */
-void remove_current_process_FIFO(void);
-void remove_current_process_RR(void);
-void remove_current_process_SJF(void);
-void remove_current_process_PSJF(void);
-
-/* A call to timeslice_over() signals that the current time slice has ended,
- * a RR scheduler should update its data structure. */
-void timeslice_over_RR(void);
-
-/* The event handler will notify when to context switch.
- * Perform a context switch when, and only when, this function is called.
- * Use suspend_process and resume_process to perform a context switch. */
-
-void context_switch_FIFO(void);
-void context_switch_RR(void);
-void context_switch_SJF(void);
-void context_switch_PSJF(void);
-
-/* The event handler may want to know if there are any more jobs in the job pool. */
-bool scheduler_empty_FIFO(void);
-bool scheduler_empty_RR(void);
-bool scheduler_empty_SJF(void);
-bool scheduler_empty_PSJF(void);
+/* Seed of the LOTTERY draws, set by --seed */
+extern unsigned long lottery_seed;
+
+/* SJF and PSJF aging, set by --aging: a waiting process gains a time unit of priority every
+ * aging_rate units it waits, or never if it is 0. */
+extern int aging_rate;
+
+/* Run time prediction for SJF and PSJF, enabled by --predict; see predict.c */
+void predict_load(const char *path);
+void predict_store(const char *path);
+void predict_arrival(ProcessInfo *p); // Sets prediction_error on its first arrival.
+void predict_terminated(ProcessInfo *p); // Learns from the time it needed, and counts its error.
+void predict_print_stats(void);
+
+/* Scheduler functions: implemented by each policy, which exports them only through its
+ * SchedulerOps, so the event dispatchers call through the table of the policy of the input and
+ * a policy is added without touching them. The scheduler is informed that an event has happened
+ * via a call. Each policy keeps a run queue per CPU, and works on the one of current_cpu. */
+typedef struct SchedulerOps {
+    const char *name; // As on the first line of the input
+    /* Initializes the data structures of the policy, which records the processes it manages. */
+    void (*set_strategy)(int num_process);
+    /* A new process has arrived. Several may arrive together, so don't perform a context switch. */
+    void (*add_process)(ProcessInfo *);
+    /* The current process has ended: remove it, but don't perform a context switch. */
+    void (*remove_current_process)(void);
+    /* The current time slice has ended, at time now in time units, the same on every CPU. The
+     * dispatcher keeps the time slices, so the policy needn't count them. NULL if the policy
+     * doesn't use time slices. */
+    void (*timeslice_over)(long now);
+    int (*timeslice_length)(void); // In time units; NULL if the policy doesn't use time slices
+    /* Perform a context switch when, and only when, this is called, with suspend_process() and
+     * resume_process(). */
+    void (*context_switch)(void);
+    bool (*scheduler_empty)(void); // Whether any job is left in the queue
+    /* Work stealing between CPUs. queue_length() counts the processes in the queue, running or
+     * not. steal_process() removes the process that would run next, other than the running one,
+     * and returns it, or returns NULL if no process is waiting. */
+    int (*queue_length)(void);
+    ProcessInfo *(*steal_process)(void);
+} SchedulerOps;
+
+extern const SchedulerOps FIFO_ops, RR_ops, SJF_ops, PSJF_ops, MLFQ_ops, EDF_ops, CFS_ops, STRIDE_ops,
+       LOTTERY_ops, HRRN_ops;
+extern const SchedulerOps *scheduler_ops; // Of current_strategy, set by set_strategy()
+
+/* Policies loaded from shared objects, implemented in plugin.c.
+ * A policy that isn't built in is looked up as NAME.so in plugin_dir, which exports its
+ * SchedulerOps as policy_ops; see plugin_lifo.c. plugin_load() exits if it can't be loaded. */
+extern const char *plugin_dir; // Set by --plugin-dir; no plugin is loaded without it
+const SchedulerOps *plugin_load(const char *name);
+
+/* Pre-forked worker pool, implemented in pool.c.
+ * pool_dispatch() hands a job to a parked worker and returns its pid,
+ * or returns 0 if no worker is parked. arrival_ns is when the process was due to arrive,
+ * on CLOCK_MONOTONIC, for run_child(). */
+void pool_init(int size);
+void pool_refill(int arrivals_left);
+pid_t pool_dispatch(int time_needed, int64_t arrival_ns);
+void pool_shutdown(void);
+
+/* Context-switch backends, implemented in switch.c.
+ * switch_attach() is called for every child forked, and switch_detach() once it has been reaped. */
+void switch_init(SwitchBackend backend);
+void switch_attach(pid_t pid);
+void switch_detach(pid_t pid);
+void switch_suspend(pid_t pid);
+void switch_resume(pid_t pid);
+void switch_release_all(void); // Before terminating the children with a signal
+void switch_shutdown(void);
+
+/* Input of the scheduler, implemented in workload.c.
+ * workload_policy() returns the first word, then workload_processes() reads the processes,
+ * which it sets up for current_strategy. The names stay valid after workload_close().
+ * With --stream, workload_count() and workload_next() read them one at a time instead.
+ * The input is either text or binary, told apart by its first bytes. */
+typedef enum WorkloadFormat {
+    TEXT_WORKLOAD, BINARY_WORKLOAD
+} WorkloadFormat;
+void workload_open(bool stream); // Maps stdin, or reads it whole (through a window if stream) if it isn't a file.
+char *workload_policy(void);
+ProcessInfo *workload_processes(int *num_process);
+int workload_count(void); // The number of processes
+void workload_next(ProcessInfo *p);
+void workload_release(ProcessInfo *p); // Frees what workload_next() allocated for p.
+void workload_close(void);
+/* Writes processes read for current_strategy as an input of the scheduler, for --convert. */
+void workload_write(FILE *fp, const char *policy, ProcessInfo *processes, int num_process, WorkloadFormat format);
+
+/* Table from pid to a value, implemented in pid_table.c. A free entry has pid 0, so the
+ * entries of every pid in it can be walked; the values must not be NULL. */
+typedef struct PidEntry {
+    pid_t pid;
+    void *value;
+} PidEntry;
+
+typedef struct PidTable {
+    PidEntry *entries;
+    int capacity; // A power of two
+    int count;
+} PidTable;
+
+void pid_table_init(PidTable *);
+void *pid_table_find(const PidTable *, pid_t pid); // NULL if pid isn't in it
+void pid_table_insert(PidTable *, pid_t pid, void *value);
+void *pid_table_remove(PidTable *, pid_t pid); // Returns its value, or NULL if pid isn't in it.
+
+/* Cache of the measured time unit, implemented in calibration.c */
+const char *calibration_cache_default(void); // NULL if there is no cache directory
+bool calibration_cache_load(const char *path, int64_t *time_unit_ns);
+void calibration_cache_store(const char *path, int64_t time_unit_ns);
+
+/* Process helpers, implemented in main.c */
+pid_t my_fork(void);
+_Noreturn void run_child(int time_needed, int64_t arrival_ns); // Runs a process in the child and never returns.
 
 /* The loop that should be run by children process */
 static inline void run_single_unit(void) {
@@ -89,9 +272,53 @@ static inline void run_single_unit(void) {
     for(i = 0; i < ITERATION_PER_TIMEUNIT; i++) {}
 }
 
+typedef struct TimerEntry {
+    struct timespec deadline;
+    EventType type; // TIMESLICE_OVER or PROCESS_ARRIVAL
+} TimerEntry;
+
+typedef struct TimerQueue {
+    TimerEntry *entries;
+    int size;
+    int capacity;
+} TimerQueue;
+
+/* Pending timers ordered by deadline, implemented in timer_queue.c */
+void timer_queue_init(TimerQueue *);
+void timer_queue_add(TimerQueue *, struct timespec deadline, EventType type);
+bool timer_queue_empty(TimerQueue *);
+struct timespec timer_queue_next_deadline(TimerQueue *);
+bool timer_queue_pop_expired(TimerQueue *, struct timespec now, TimerEntry *expired);
+
+typedef struct HeapNode {
+    int key; // remaining_time (or edf_deadline) of the process when it was inserted or last updated
+    pid_t pid; // Breaks ties
+    ProcessInfo *process;
+} HeapNode;
+
+#define RADIX_BUCKETS 65 // One per bit of a 64-bit key, plus one for the last minimum
+
+typedef struct RadixBucket {
+    HeapNode *nodes;
+    int size;
+    int capacity;
+} RadixBucket;
+
+typedef enum HeapKey { // The field of ProcessInfo that orders a heap
+    REMAINING_TIME_KEY, // The remaining time, as predicted with --predict
+    DEADLINE_KEY,
+    AGED_KEY // The remaining time, less the time waited divided by aging_rate, relative to time 0
+} HeapKey;
+
 typedef struct Heap {
-    ProcessInfo **pq;
+    HeapNode *nodes; // The 4-ary heap
     int heap_size;
+    int heap_capacity;
+    HeapKey key;
+    bool radix; // Whether keys that aren't below the last minimum go to the radix heap
+    uint64_t radix_last; // The last minimum of the radix heap, packed by radix_key()
+    int radix_size;
+    RadixBucket buckets[RADIX_BUCKETS];
 } Heap;
 
 void scheduler_exit(int exit_code);
@@ -109,20 +336,61 @@ inline void set_priority(pid_t pid, int priority)
 }
 
 static inline void suspend_process(pid_t pid) {
-    set_priority(pid, sched_get_priority_min(SCHED_FIFO));
-    // kill(pid, SIGSTOP);
+    if (simulation_mode) {
+        sim_suspend_process(pid);
+        return;
+    }
+    switch_suspend(pid);
 }
 
 static inline void resume_process(pid_t pid) {
-    set_priority(pid, sched_get_priority_max(SCHED_FIFO)-1);
-    // kill(pid, SIGCONT);
+    if (simulation_mode) {
+        sim_resume_process(pid);
+        return;
+    }
+    switch_resume(pid);
 }
 
+typedef struct RbTree {
+    ProcessInfo nil; // The leaves
+    ProcessInfo *root;
+    ProcessInfo *leftmost; // NULL if the tree is empty
+} RbTree;
+
+/* Red-black tree ordered by (vruntime, pid), implemented in rbtree.c */
+void rbtree_init(RbTree *);
+void rbtree_insert(RbTree *, ProcessInfo *p);
+void rbtree_erase(RbTree *, ProcessInfo *p);
+ProcessInfo *rbtree_first(RbTree *); // The leftmost process, or NULL
+bool rbtree_before(const ProcessInfo *lhs, const ProcessInfo *rhs);
+
 void heap_insert(Heap *,ProcessInfo *p);
-void heap_init(Heap* p, int max_size);
+void heap_init(Heap* p, int expected_size); // Uses the radix heap if expected_size is large enough to pay off
+void heap_init_key(Heap *, int expected_size, HeapKey key);
+void heap_init_radix(Heap *, bool radix);
+void heap_free(Heap *);
 ProcessInfo *heap_top(Heap *);
 void heap_pop(Heap *);
+void heap_update(Heap *, ProcessInfo *p); // After the key of p has changed
+void heap_remove(Heap *, ProcessInfo *p);
+int heap_processes(Heap *, ProcessInfo **processes); // Copies them in no particular order; returns how many
 int heap_size(Heap *);
 bool heap_empty(Heap *);
 
+typedef struct PreemptiveQueue {
+    Heap pq; // Every process of the CPU, the running one on top after a context switch
+    ProcessInfo *active_process;
+    int last_context_switch_time;
+    int current_time; // Worked out from the arrivals and the terminations
+} PreemptiveQueue;
+
+/* Preemptive run queue of PSJF and EDF, whose heap key picks the process to run, implemented
+ * in preemptive.c */
+void preemptive_init(PreemptiveQueue *, int expected_size, HeapKey key);
+ProcessInfo *preemptive_arrive(PreemptiveQueue *, ProcessInfo *p); // Charges the running process until p arrives and returns it, or NULL if nothing was charged; p isn't queued yet
+ProcessInfo *preemptive_terminate(PreemptiveQueue *); // Takes out the running process, which has terminated, and returns it
+void preemptive_context_switch(PreemptiveQueue *);
+bool preemptive_empty(PreemptiveQueue *);
+ProcessInfo *preemptive_steal(PreemptiveQueue *); // Takes out the next process to run but the running one, or returns NULL
+
 #endif
@@ -0,0 +1,197 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include "scheduler.h"
+
+/* Discrete-event simulation of the scheduler.
+ *
+ * The schedulers (FIFO.c, RR.c and the others) are driven through the same event dispatchers as
+ * in main(), but nothing is forked and no timer is set. Instead the virtual clock jumps straight
+ * to the next event: a child terminating, a time slice ending, or a process arriving.
+ *
+ * suspend_process() and resume_process() end up here, where the kernel's SCHED_FIFO run list
+ * of each CPU is modelled: a resumed child is appended to the list of children at the higher
+ * priority on its CPU, a suspended one is removed from it, and the child at the head of the list
+ * is the one running on that CPU. A child moved to another CPU is appended to the list there.
+ * Fake pids are handed out in arrival order, which is the order fork() gives them in main().
+ * A child is dropped when it terminates, and its process is handed to retire_process().
+ */
+
+#define NO_EVENT LONG_MAX
+
+/* A child that has arrived and not terminated */
+typedef struct SimChild {
+    ProcessInfo *process;
+    long work_left; // Units of work the child still has to do
+    struct SimChild *runlist_next, *runlist_prev; // NULL terminates the list.
+    bool runnable; // Whether the child is in the run list
+} SimChild;
+
+/* The children by pid: only the children alive are in it, so it doesn't grow with the input
+ * when the processes are streamed. */
+static PidTable children;
+static pid_t last_pid = 0;
+static SimChild **runlist_head, **runlist_tail; // Indexed by CPU
+static pid_t *last_running; // Indexed by CPU. The child that ran last on it, or 0.
+static long switch_count, preemption_count; // A preemption is a switch away from a child that hasn't terminated.
+
+static SimChild *child_of(pid_t pid) {
+    SimChild *child = (SimChild *) pid_table_find(&children, pid);
+    assert(child != NULL);
+    return child;
+}
+
+void sim_resume_process(pid_t pid) {
+    SimChild *child = child_of(pid);
+    if (child->runnable) {
+        return;
+    }
+    int cpu = child->process->cpu;
+    child->runnable = true;
+    child->runlist_prev = runlist_tail[cpu];
+    child->runlist_next = NULL;
+    if (runlist_tail[cpu] != NULL) {
+        runlist_tail[cpu]->runlist_next = child;
+    } else {
+        runlist_head[cpu] = child;
+    }
+    runlist_tail[cpu] = child;
+}
+
+void sim_suspend_process(pid_t pid) {
+    SimChild *child = child_of(pid);
+    if (!child->runnable) {
+        return;
+    }
+    int cpu = child->process->cpu;
+    child->runnable = false;
+    if (child->runlist_prev != NULL) {
+        child->runlist_prev->runlist_next = child->runlist_next;
+    } else {
+        runlist_head[cpu] = child->runlist_next;
+    }
+    if (child->runlist_next != NULL) {
+        child->runlist_next->runlist_prev = child->runlist_prev;
+    } else {
+        runlist_tail[cpu] = child->runlist_prev;
+    }
+}
+
+void sim_move_process(pid_t pid, int cpu) {
+    SimChild *child = child_of(pid);
+    if (!child->runnable) {
+        return; // move_process() sets its CPU.
+    }
+    sim_suspend_process(pid);
+    child->process->cpu = cpu;
+    sim_resume_process(pid);
+}
+
+/* Whether the child with that pid, or 0, hasn't terminated */
+static bool unfinished(pid_t pid) {
+    SimChild *child = pid != 0 ? (SimChild *) pid_table_find(&children, pid) : NULL;
+    return child != NULL && child->work_left > 0;
+}
+
+static void sim_init(void) {
+    pid_table_init(&children);
+    runlist_head = (SimChild **) calloc(num_cpus, sizeof(SimChild *));
+    runlist_tail = (SimChild **) calloc(num_cpus, sizeof(SimChild *));
+    last_running = (pid_t *) calloc(num_cpus, sizeof(pid_t));
+    switch_count = preemption_count = 0;
+}
+
+static long min_event(long lhs, long rhs) {
+    return lhs < rhs ? lhs : rhs;
+}
+
+/* Each time slice lasts the timeslice_length() of when it starts, just like the timer in main().
+ * While no child is running, the slices that end before the next arrival change nothing,
+ * so they are skipped. */
+static long skip_idle_timeslices(long next_slice, long next_arrival, int slice_length) {
+    if (next_slice == NO_EVENT || next_arrival == NO_EVENT || next_slice > next_arrival) {
+        return next_slice;
+    }
+    return next_slice + ((next_arrival - next_slice) / slice_length + 1) * slice_length;
+}
+
+void run_simulation(void) {
+    sim_init();
+    long now = 0;
+    long next_slice = timeslice_length() > 0 ? timeslice_length() : NO_EVENT;
+
+    while (true) {
+        long exit_time = NO_EVENT;
+        int exit_cpu = -1;
+        for (int cpu = 0; cpu < num_cpus; cpu++) {
+            SimChild *running = runlist_head[cpu];
+            if (running != NULL && now + running->work_left < exit_time) {
+                exit_time = now + running->work_left;
+                exit_cpu = cpu;
+            }
+        }
+        long arrival_time = !arrival_queue_empty() ? next_arrival()->arrival_time : NO_EVENT;
+        if (exit_cpu < 0) {
+            next_slice = skip_idle_timeslices(next_slice, arrival_time, timeslice_length());
+        }
+        long event_time = min_event(exit_time, min_event(next_slice, arrival_time));
+        assert(event_time != NO_EVENT);
+        assert(event_time >= now); // Arrivals come in order, see arrivals.c.
+
+        for (int cpu = 0; cpu < num_cpus && event_time > now; cpu++) {
+            SimChild *running = runlist_head[cpu];
+            if (running == NULL) {
+                continue;
+            }
+            if (running->process->start_time < 0) {
+                running->process->start_time = now;
+            }
+            if (running->process->pid != last_running[cpu]) {
+                switch_count++;
+                if (unfinished(last_running[cpu])) {
+                    preemption_count++;
+                }
+                last_running[cpu] = running->process->pid;
+            }
+            running->work_left -= event_time - now;
+        }
+        now = event_time;
+
+        /* On a tie, a terminated child is handled first, and a time slice ending is handled
+         * before an arrival, as handle_expired_timers() does. Children terminating together
+         * on several CPUs are handled one at a time, from the lowest CPU. */
+        if (exit_time == now) {
+            ProcessInfo *p = runlist_head[exit_cpu]->process;
+            if (p->start_time < 0) {
+                p->start_time = now; // Nothing to run at all
+            }
+            p->finish_time = now;
+            sim_suspend_process(p->pid);
+            remove_current_process(exit_cpu);
+            free(pid_table_remove(&children, p->pid));
+            retire_process(p);
+        } else if (next_slice == now) {
+            timeslice_over(now);
+            next_slice += timeslice_length();
+        } else {
+            do {
+                SimChild *child = (SimChild *) calloc(1, sizeof(SimChild));
+                child->process = get_arrived_process();
+                child->process->pid = ++last_pid;
+                child->work_left = child->process->time_needed;
+                pid_table_insert(&children, child->process->pid, child);
+                admit_process(child->process);
+            } while (!arrival_queue_empty() && next_arrival()->arrival_time == now);
+        }
+
+        cpus_account(now);
+        if (arrival_queue_empty() && scheduler_empty()) {
+            break;
+        }
+        context_switch();
+    }
+}
+
+void sim_print_stats(void) {
+    fprintf(stderr, "context switches: %ld, %ld of them preemptions\n", switch_count, preemption_count);
+}
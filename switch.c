@@ -0,0 +1,202 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "scheduler.h"
+
+/* Context-switch backends, selected with --switch.
+ *
+ * PRIORITY_SWITCH moves a child between two SCHED_FIFO priorities: the resumed children run
+ * before the suspended ones, which only run when nothing else is runnable on their CPU.
+ * SIGNAL_SWITCH stops a child with SIGSTOP and continues it with SIGCONT.
+ * CGROUP_SWITCH puts every child in its own cgroup v2 group and writes its cgroup.freeze.
+ * With the last two, a suspended child can't run at all, and every child stays at the higher priority.
+ * In every backend, a child that is resumed is queued behind the children of its CPU already running.
+ */
+
+SwitchBackend switch_backend = PRIORITY_SWITCH;
+
+extern inline void set_priority(pid_t pid, int priority);
+
+/* The cgroup.freeze of a child */
+typedef struct FreezeHandle {
+    int fd;
+} FreezeHandle;
+
+static char cgroup_dir[PATH_MAX]; // The group holding the group of each child
+static PidTable freeze_handles; // Of every child, by pid
+
+static void switch_error(const char *what, pid_t pid) {
+    char errmsg[100];
+    sprintf(errmsg, "%s %d!", what, pid);
+    perror(errmsg);
+    scheduler_exit(1);
+}
+
+/* The group of a child, or a file in it if file isn't NULL. */
+static void child_cgroup_path(char *path, pid_t pid, const char *file) {
+    int len = snprintf(path, PATH_MAX, "%s/%d%s%s", cgroup_dir, (int) pid, file ? "/" : "", file ? file : "");
+    if (len >= PATH_MAX) {
+        fprintf(stderr, "The cgroup path of pid %d is too long\n", (int) pid);
+        scheduler_exit(1);
+    }
+}
+
+static void write_file(const char *path, const char *text) {
+    int fd = open(path, O_WRONLY);
+    if (fd == -1 || write(fd, text, strlen(text)) == -1) {
+        perror(path);
+        scheduler_exit(1);
+    }
+    close(fd);
+}
+
+/* The cgroup v2 group of this process, e.g. /sys/fs/cgroup/user.slice/session-1.scope */
+static void find_own_cgroup(char *path, size_t size) {
+    char mount_point[PATH_MAX] = "", line[PATH_MAX + 64];
+    FILE *fp = fopen("/proc/self/mounts", "r");
+    while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+        char type[32];
+        if (sscanf(line, "%*s %4095s %31s", mount_point, type) == 2 && !strcmp(type, "cgroup2")) {
+            break;
+        }
+        mount_point[0] = '\0';
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    char group[PATH_MAX] = "";
+    fp = fopen("/proc/self/cgroup", "r");
+    while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+        if (!strncmp(line, "0::", 3)) {
+            sscanf(line + 3, "%4095s", group);
+        }
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    if (mount_point[0] == '\0') {
+        fprintf(stderr, "--switch cgroup needs cgroup v2 to be mounted\n");
+        exit(1);
+    }
+    if (snprintf(path, size, "%s%s", mount_point, strcmp(group, "/") ? group : "") >= (int) size) {
+        fprintf(stderr, "The cgroup path is too long\n");
+        exit(1);
+    }
+}
+
+void switch_init(SwitchBackend backend) {
+    switch_backend = backend;
+    if (backend != CGROUP_SWITCH) {
+        return;
+    }
+    char own[PATH_MAX];
+    find_own_cgroup(own, sizeof(own));
+    if (snprintf(cgroup_dir, sizeof(cgroup_dir), "%s/scheduler-%d", own, (int) getpid()) >= (int) sizeof(cgroup_dir)
+            || mkdir(cgroup_dir, 0755) == -1) {
+        perror(cgroup_dir);
+        exit(1);
+    }
+    pid_table_init(&freeze_handles);
+}
+
+void switch_attach(pid_t pid) {
+    if (switch_backend != CGROUP_SWITCH) {
+        return;
+    }
+    char path[PATH_MAX], text[16];
+    child_cgroup_path(path, pid, NULL);
+    if (mkdir(path, 0755) == -1) {
+        switch_error("Can't create the cgroup of pid", pid);
+    }
+    child_cgroup_path(path, pid, "cgroup.procs");
+    sprintf(text, "%d", (int) pid);
+    write_file(path, text);
+
+    child_cgroup_path(path, pid, "cgroup.freeze");
+    FreezeHandle *handle = (FreezeHandle *) malloc(sizeof(FreezeHandle));
+    handle->fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (handle->fd == -1) {
+        switch_error("Can't open cgroup.freeze of pid", pid);
+    }
+    pid_table_insert(&freeze_handles, pid, handle);
+}
+
+void switch_detach(pid_t pid) {
+    if (switch_backend != CGROUP_SWITCH) {
+        return;
+    }
+    FreezeHandle *handle = (FreezeHandle *) pid_table_remove(&freeze_handles, pid);
+    if (handle == NULL) {
+        return;
+    }
+    close(handle->fd);
+    free(handle);
+    char path[PATH_MAX];
+    child_cgroup_path(path, pid, NULL);
+    rmdir(path); // The child has been reaped, so the group is empty.
+}
+
+static void write_freeze(pid_t pid, const char *state) {
+    FreezeHandle *handle = (FreezeHandle *) pid_table_find(&freeze_handles, pid);
+    if (handle == NULL || write(handle->fd, state, 1) != 1) {
+        switch_error("Can't write cgroup.freeze of pid", pid);
+    }
+}
+
+void switch_suspend(pid_t pid) {
+    switch (switch_backend) {
+        case PRIORITY_SWITCH:
+            set_priority(pid, sched_get_priority_min(SCHED_FIFO));
+            break;
+        case SIGNAL_SWITCH:
+            if (kill(pid, SIGSTOP) == -1) {
+                switch_error("Can't stop pid", pid);
+            }
+            break;
+        case CGROUP_SWITCH:
+            write_freeze(pid, "1");
+            break;
+    }
+}
+
+void switch_resume(pid_t pid) {
+    switch (switch_backend) {
+        case PRIORITY_SWITCH:
+            set_priority(pid, sched_get_priority_max(SCHED_FIFO)-1);
+            break;
+        case SIGNAL_SWITCH:
+            if (kill(pid, SIGCONT) == -1) {
+                switch_error("Can't continue pid", pid);
+            }
+            break;
+        case CGROUP_SWITCH:
+            write_freeze(pid, "0");
+            break;
+    }
+}
+
+/* Lets every suspended child run, so that it can receive the signal that terminates it.
+ * Errors are ignored; this is called on the way out. */
+void switch_release_all(void) {
+    if (switch_backend == SIGNAL_SWITCH) {
+        kill(0, SIGCONT);
+    } else if (switch_backend == CGROUP_SWITCH) {
+        for (int i = 0; i < freeze_handles.capacity; i++) {
+            if (freeze_handles.entries[i].pid != 0) {
+                ssize_t res = write(((FreezeHandle *) freeze_handles.entries[i].value)->fd, "0", 1);
+                (void) res;
+            }
+        }
+    }
+}
+
+void switch_shutdown(void) {
+    if (switch_backend == CGROUP_SWITCH) {
+        rmdir(cgroup_dir);
+    }
+}
@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include "scheduler.h"
+
+/* A queue of pending timers, ordered by deadline in a binary min-heap.
+ *
+ * The event loop arms a single kernel timer with the earliest deadline. When it fires,
+ * every timer whose deadline has passed is popped, so timers that expire at the same time
+ * are delivered together instead of one of them being lost.
+ * Deadlines are absolute CLOCK_MONOTONIC times.
+ */
+
+#define TIMER_QUEUE_INITIAL_CAPACITY 4
+
+static bool timer_entry_lt(TimerQueue *q, int lhsIdx, int rhsIdx) {
+    const struct timespec *lhs = &q->entries[lhsIdx].deadline;
+    const struct timespec *rhs = &q->entries[rhsIdx].deadline;
+    if (lhs->tv_sec == rhs->tv_sec) {
+        return lhs->tv_nsec < rhs->tv_nsec;
+    }
+    return lhs->tv_sec < rhs->tv_sec;
+}
+
+static void timer_entry_swap(TimerQueue *q, int lhs, int rhs) {
+    TimerEntry temp = q->entries[lhs];
+    q->entries[lhs] = q->entries[rhs];
+    q->entries[rhs] = temp;
+}
+
+static void timer_upheap(TimerQueue *q, int childIdx) {
+    while (childIdx > 0 && timer_entry_lt(q, childIdx, (childIdx - 1) / 2)) {
+        timer_entry_swap(q, childIdx, (childIdx - 1) / 2);
+        childIdx = (childIdx - 1) / 2;
+    }
+}
+
+static void timer_downheap(TimerQueue *q, int parentIdx) {
+    while (parentIdx * 2 + 1 < q->size) {
+        int minIdx = parentIdx;
+        int lchild = parentIdx * 2 + 1, rchild = parentIdx * 2 + 2;
+        if (timer_entry_lt(q, lchild, minIdx)) {
+            minIdx = lchild;
+        }
+        if (rchild < q->size && timer_entry_lt(q, rchild, minIdx)) {
+            minIdx = rchild;
+        }
+        if (minIdx == parentIdx) {
+            break;
+        }
+        timer_entry_swap(q, parentIdx, minIdx);
+        parentIdx = minIdx;
+    }
+}
+
+static void timer_queue_remove_at(TimerQueue *q, int idx) {
+    q->size--;
+    if (idx == q->size) {
+        return;
+    }
+    q->entries[idx] = q->entries[q->size];
+    timer_upheap(q, idx);
+    timer_downheap(q, idx);
+}
+
+void timer_queue_init(TimerQueue *q) {
+    q->capacity = TIMER_QUEUE_INITIAL_CAPACITY;
+    q->entries = (TimerEntry *) malloc(sizeof(TimerEntry) * q->capacity);
+    q->size = 0;
+}
+
+void timer_queue_add(TimerQueue *q, struct timespec deadline, EventType type) {
+    if (q->size == q->capacity) {
+        q->capacity *= 2;
+        q->entries = (TimerEntry *) realloc(q->entries, sizeof(TimerEntry) * q->capacity);
+    }
+    q->entries[q->size].deadline = deadline;
+    q->entries[q->size].type = type;
+    q->size++;
+    timer_upheap(q, q->size - 1);
+}
+
+bool timer_queue_empty(TimerQueue *q) {
+    return q->size == 0;
+}
+
+struct timespec timer_queue_next_deadline(TimerQueue *q) {
+    return q->entries[0].deadline;
+}
+
+bool timer_queue_pop_expired(TimerQueue *q, struct timespec now, TimerEntry *expired) {
+    if (q->size == 0) {
+        return false;
+    }
+    struct timespec *deadline = &q->entries[0].deadline;
+    if (deadline->tv_sec > now.tv_sec || (deadline->tv_sec == now.tv_sec && deadline->tv_nsec > now.tv_nsec)) {
+        return false;
+    }
+    *expired = q->entries[0];
+    timer_queue_remove_at(q, 0);
+    return true;
+}
@@ -0,0 +1,513 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "scheduler.h"
+
+/* The input of the scheduler: the policy, the number of processes, then one line per process,
+ * "name arrival_time time_needed" and an optional fourth column.
+ *
+ * When stdin is a file, it is mapped instead of read, and scanned by hand rather than with
+ * scanf(). The names are copied, NUL-terminated, one after the other in a single arena, which
+ * is as large as the input but only takes memory for the bytes written. The pages of the input
+ * that have been scanned are given back every WORKLOAD_RELEASE_BYTES, so the input doesn't
+ * stay in memory next to the processes. Any other stdin, such as a pipe, is read whole first.
+ *
+ * With --stream, the processes are read one at a time by workload_next(), as they arrive. A
+ * stdin that isn't a file is then read through a window of WORKLOAD_WINDOW bytes instead, which
+ * is refilled before each process so that at least half of it is left to scan, and each name
+ * has an allocation of its own, which workload_release() frees.
+ *
+ * The input may also be binary, as written by workload_write() (./main --convert binary), which
+ * starts with WORKLOAD_MAGIC. All numbers in it are LEB128 varints, the signed ones zigzag-encoded:
+ *     WORKLOAD_MAGIC, the length and bytes of the policy, the number of processes,
+ *     the size of the name table, then the name table: the distinct names, each followed by a NUL,
+ *     then for each process: its arrival time minus the one of the previous process (signed),
+ *     its time needed, the offset of its name in the table minus the one of the previous process
+ *     (signed), and its fourth column plus one (signed), or 0 if it has none.
+ * Nothing has to be scanned for, and a name shared by many processes is stored once. The names
+ * are copied into the arena at once, and the processes point into it.
+ */
+
+#define WORKLOAD_RELEASE_BYTES (8 << 20)
+#define WORKLOAD_READ_CHUNK (1 << 20)
+#define WORKLOAD_WINDOW (2 * WORKLOAD_READ_CHUNK) // With --stream, of a stdin that isn't a file
+#define WORKLOAD_MAGIC "\x7fWKLOAD1" // No text input starts with DEL.
+#define WORKLOAD_MAGIC_SIZE 8
+
+static char *input; // All of stdin, mapped or read, or its window
+static size_t input_size;
+static bool mapped;
+static bool streaming; // With --stream
+static bool input_ended; // Whether the window has reached the end of stdin
+static long window_offset; // Of input in stdin, for the error messages
+static const char *cursor, *input_end;
+static const char *released; // The input before this has been given back to the kernel
+static char *arena; // Of the names, unless streaming
+static int line = 1; // Of cursor, for the error messages
+static bool binary; // Whether the input starts with WORKLOAD_MAGIC
+static char *name_table; // Of a binary input
+static uint64_t name_table_size;
+static int64_t last_arrival_time, last_name_offset; // Of the last process read from a binary input
+
+static void read_whole_stdin(void) {
+    size_t capacity = WORKLOAD_READ_CHUNK;
+    input = (char *) malloc(capacity);
+    ssize_t n;
+    while ((n = read(STDIN_FILENO, input + input_size, capacity - input_size)) > 0) {
+        input_size += n;
+        if (input_size == capacity) {
+            capacity *= 2;
+            input = (char *) realloc(input, capacity);
+        }
+    }
+    if (n < 0) {
+        perror("Can't read the input");
+        exit(1);
+    }
+}
+
+void workload_open(bool stream) {
+    streaming = stream;
+    struct stat st;
+    off_t offset = lseek(STDIN_FILENO, 0, SEEK_CUR);
+    if (fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode) && offset >= 0 && st.st_size > offset) {
+        input_size = st.st_size;
+        input = (char *) mmap(NULL, input_size, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+        if (input == MAP_FAILED) {
+            perror("Can't map the input");
+            exit(1);
+        }
+        madvise(input, input_size, MADV_SEQUENTIAL);
+        mapped = true;
+        cursor = input + offset; // Something may have read the beginning already.
+    } else if (streaming) {
+        input = (char *) malloc(WORKLOAD_WINDOW);
+        cursor = input; // Empty until the first refill()
+    } else {
+        read_whole_stdin();
+        cursor = input;
+    }
+    input_end = input + input_size;
+    released = input;
+    if (!streaming) {
+        arena = (char *) malloc(input_size + 1); // A name takes at most its bytes and the one after it.
+    }
+}
+
+void workload_close(void) {
+    if (mapped) {
+        munmap(input, input_size);
+    } else {
+        free(input);
+    }
+    input = NULL;
+}
+
+static _Noreturn void input_error(const char *what);
+
+/* Moves what is left to scan to the front of the window, and reads stdin after it until the
+ * window is full, unless at least half of it is left to scan. */
+static void refill(void) {
+    if (mapped || !streaming || input_ended || input_end - cursor >= WORKLOAD_WINDOW / 2) {
+        return;
+    }
+    size_t left = input_end - cursor;
+    window_offset += cursor - input;
+    memmove(input, cursor, left);
+    input_size = left;
+    while (!input_ended && input_size < WORKLOAD_WINDOW) {
+        ssize_t n = read(STDIN_FILENO, input + input_size, WORKLOAD_WINDOW - input_size);
+        if (n < 0 && errno != EINTR) {
+            perror("Can't read the input");
+            exit(1);
+        }
+        input_ended = n == 0;
+        input_size += n > 0 ? n : 0;
+    }
+    cursor = input;
+    input_end = input + input_size;
+}
+
+/* Memory for the names: one allocation each when streaming, so that they can be freed */
+static char *allocate(size_t size) {
+    if (streaming) {
+        return (char *) malloc(size);
+    }
+    char *memory = arena;
+    arena += size;
+    return memory;
+}
+
+static _Noreturn void input_error(const char *what) {
+    fprintf(stderr, "Line %d of the input: %s\n", line, what);
+    exit(1);
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static void skip_spaces(void) {
+    while (cursor < input_end && is_space(*cursor)) {
+        line += *cursor == '\n';
+        cursor++;
+    }
+}
+
+/* The next word, copied */
+static char *next_word(const char *what) {
+    skip_spaces();
+    if (cursor == input_end) {
+        input_error(what);
+    }
+    const char *begin = cursor;
+    while (cursor < input_end && !is_space(*cursor)) {
+        cursor++;
+    }
+    if (cursor == input_end && streaming && !mapped && !input_ended) {
+        input_error("a word is longer than half of the read window");
+    }
+    char *word = allocate(cursor - begin + 1);
+    memcpy(word, begin, cursor - begin);
+    word[cursor - begin] = '\0';
+    return word;
+}
+
+/* Parses a number at cursor, or returns false if there is none. */
+static bool parse_int(int *value) {
+    bool negative = cursor < input_end && *cursor == '-';
+    const char *digits = cursor + negative;
+    const char *p = digits;
+    int v = 0;
+    while (p < input_end && (unsigned) (*p - '0') < 10) {
+        v = v * 10 + (*p - '0');
+        p++;
+    }
+    if (p == digits || (p < input_end && !is_space(*p))) {
+        return false;
+    }
+    cursor = p;
+    *value = negative ? -v : v;
+    return true;
+}
+
+static int next_int(const char *what) {
+    skip_spaces();
+    int value;
+    if (!parse_int(&value)) {
+        input_error(what);
+    }
+    return value;
+}
+
+/* Whether something else is on the line of cursor */
+static bool more_on_line(void) {
+    while (cursor < input_end && (*cursor == ' ' || *cursor == '\t')) {
+        cursor++;
+    }
+    return cursor < input_end && *cursor != '\n' && *cursor != '\r';
+}
+
+/* Gives the pages that have been scanned back to the kernel. */
+static void release_scanned(void) {
+    if (!mapped || cursor - released < WORKLOAD_RELEASE_BYTES) {
+        return;
+    }
+    long page_size = sysconf(_SC_PAGESIZE);
+    const char *end = input + (cursor - input) / page_size * page_size;
+    madvise((void *) released, end - released, MADV_DONTNEED);
+    released = end;
+}
+
+static _Noreturn void binary_error(const char *what) {
+    fprintf(stderr, "Byte %ld of the binary input: %s\n", window_offset + (long) (cursor - input), what);
+    exit(1);
+}
+
+static uint64_t next_varint(const char *what) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (cursor == input_end) {
+            binary_error(what);
+        }
+        unsigned char byte = *cursor++;
+        value |= (uint64_t) (byte & 0x7f) << shift;
+        if (byte < 0x80) {
+            return value;
+        }
+    }
+    binary_error(what);
+}
+
+static int64_t next_signed_varint(const char *what) {
+    uint64_t value = next_varint(what);
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+static int to_int(int64_t value, const char *what) {
+    if (value < INT_MIN || value > INT_MAX) {
+        binary_error(what);
+    }
+    return (int) value;
+}
+
+/* The next size bytes of the input, copied, followed by a NUL */
+static char *next_bytes(uint64_t size, const char *what) {
+    if (!streaming && size > (uint64_t) (input_end - cursor)) {
+        binary_error(what);
+    }
+    char *bytes = allocate(size + 1);
+    for (uint64_t copied = 0; copied < size; ) {
+        refill(); // The name table may not fit in the window.
+        size_t n = size - copied < (uint64_t) (input_end - cursor) ? size - copied : (size_t) (input_end - cursor);
+        if (n == 0) {
+            binary_error(what);
+        }
+        memcpy(bytes + copied, cursor, n);
+        cursor += n;
+        copied += n;
+    }
+    bytes[size] = '\0';
+    return bytes;
+}
+
+char *workload_policy(void) {
+    refill();
+    binary = input_end - cursor >= WORKLOAD_MAGIC_SIZE && !memcmp(cursor, WORKLOAD_MAGIC, WORKLOAD_MAGIC_SIZE);
+    if (!binary) {
+        return next_word("the name of the policy is missing");
+    }
+    cursor += WORKLOAD_MAGIC_SIZE;
+    return next_bytes(next_varint("the name of the policy is missing"), "the name of the policy is cut");
+}
+
+static bool weighted(void) {
+    return current_strategy == CFS || current_strategy == STRIDE || current_strategy == LOTTERY;
+}
+
+static int default_weight(void) {
+    return current_strategy == CFS ? CFS_DEFAULT_WEIGHT : DEFAULT_TICKETS;
+}
+
+/* The fourth column is optional: the weight for CFS, the tickets for STRIDE and LOTTERY,
+ * the deadline otherwise. */
+static void set_fourth_column(ProcessInfo *p, bool valid, int value) {
+    if (weighted()) {
+        if (!valid || value <= 0) {
+            fprintf(stderr, "%s: the %s must be a positive number\n", p->name,
+                    current_strategy == CFS ? "weight" : "number of tickets");
+            exit(1);
+        }
+        p->weight = value;
+    } else if (!valid) {
+        fprintf(stderr, "%s: the deadline must be a number of time units\n", p->name);
+        exit(1);
+    } else {
+        p->deadline = value;
+    }
+}
+
+/* The fourth column to write for p, or false if it has none */
+static bool fourth_column(const ProcessInfo *p, int *value) {
+    *value = weighted() ? p->weight : p->deadline;
+    return weighted() ? p->weight != default_weight() : p->deadline != NO_DEADLINE;
+}
+
+static void init_process(ProcessInfo *p, char *name, int arrival_time, int time_needed) {
+    p->name = name;
+    p->arrival_time = arrival_time;
+    p->time_needed = time_needed;
+    p->remaining_time = p->time_needed;
+    p->status = NOT_STARTED;
+    p->pid = 0;
+    p->start_time = p->finish_time = -1;
+    p->cpu = -1;
+    p->heap_index = -1;
+    p->heap_bucket = -1;
+    p->mlfq_level = p->mlfq_slices = p->mlfq_generation = 0;
+    p->admission = NOT_ADMITTED;
+    p->edf_node = NULL;
+    p->deadline = p->edf_deadline = NO_DEADLINE;
+    p->weight = default_weight();
+    p->vruntime = 0;
+    p->queue_slot = -1;
+    p->wait_origin = p->arrival_time;
+    p->prediction_error = 0;
+}
+
+static void read_process(ProcessInfo *p) {
+    char *name = next_word("the input ends before the last process");
+    int arrival_time = next_int("the ready time must be a number");
+    int time_needed = next_int("the execution time must be a number");
+    init_process(p, name, arrival_time, time_needed);
+    if (more_on_line()) {
+        int value = 0;
+        bool valid = parse_int(&value);
+        set_fourth_column(p, valid, value);
+    }
+}
+
+static void read_binary_process(ProcessInfo *p) {
+    last_arrival_time += next_signed_varint("the input ends before the last process");
+    int time_needed = to_int(next_varint("the execution time is missing"), "the execution time is too large");
+    last_name_offset += next_signed_varint("the name is missing");
+    if (last_name_offset < 0 || (uint64_t) last_name_offset >= name_table_size) {
+        binary_error("the name is not in the name table");
+    }
+    init_process(p, name_table + last_name_offset, to_int(last_arrival_time, "the ready time is too large"), time_needed);
+    int64_t fourth = next_signed_varint("the fourth column is missing");
+    if (fourth != 0) {
+        set_fourth_column(p, true, to_int(fourth - 1, "the fourth column is too large"));
+    }
+}
+
+int workload_count(void) {
+    refill();
+    if (!binary) {
+        return next_int("the number of processes must be a number");
+    }
+    int num_process = to_int(next_varint("the number of processes is missing"), "too many processes");
+    name_table_size = next_varint("the size of the name table is missing");
+    name_table = next_bytes(name_table_size, "the name table is cut");
+    if (name_table_size > 0 && name_table[name_table_size - 1] != '\0') {
+        binary_error("the last name of the table isn't terminated");
+    }
+    return num_process;
+}
+
+void workload_next(ProcessInfo *p) {
+    refill();
+    if (binary) {
+        read_binary_process(p);
+    } else {
+        read_process(p);
+    }
+    release_scanned();
+}
+
+void workload_release(ProcessInfo *p) {
+    if (streaming && !binary) {
+        free(p->name); // The names of a binary input stay in its name table.
+    }
+}
+
+ProcessInfo *workload_processes(int *num_process) {
+    *num_process = workload_count();
+    ProcessInfo *processes = (ProcessInfo *) malloc(*num_process * sizeof(ProcessInfo));
+    for (int i = 0; i < *num_process; i++) {
+        workload_next(&processes[i]);
+    }
+    return processes;
+}
+
+static void put_varint(FILE *fp, uint64_t value) {
+    while (value >= 0x80) {
+        putc_unlocked((value & 0x7f) | 0x80, fp);
+        value >>= 7;
+    }
+    putc_unlocked(value, fp);
+}
+
+static void put_signed_varint(FILE *fp, int64_t value) {
+    put_varint(fp, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+}
+
+static uint64_t name_hash(const char *name) {
+    uint64_t hash = 14695981039346656037ULL; // FNV-1a, as in predict.c
+    for (; *name; name++) {
+        hash ^= (unsigned char) *name;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* Lays out the distinct names in the order they first appear, and sets the offset of the name of
+ * each process in that table. Returns the size of the table. */
+static uint64_t lay_out_names(ProcessInfo *processes, int num_process, uint64_t *name_offset,
+        ProcessInfo **first_use, int *num_names) {
+    int capacity = 16;
+    while (capacity < 2 * num_process) {
+        capacity *= 2;
+    }
+    int *slots = (int *) malloc(capacity * sizeof(int)); // Index of the first process with the name, or -1
+    memset(slots, -1, capacity * sizeof(int));
+    uint64_t table_size = 0;
+    *num_names = 0;
+    for (int i = 0; i < num_process; i++) {
+        int slot = name_hash(processes[i].name) & (capacity - 1);
+        while (slots[slot] >= 0 && strcmp(processes[slots[slot]].name, processes[i].name)) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (slots[slot] < 0) {
+            slots[slot] = i;
+            first_use[(*num_names)++] = &processes[i];
+            name_offset[i] = table_size;
+            table_size += strlen(processes[i].name) + 1;
+        } else {
+            name_offset[i] = name_offset[slots[slot]];
+        }
+    }
+    free(slots);
+    return table_size;
+}
+
+static void write_binary(FILE *fp, const char *policy, ProcessInfo *processes, int num_process) {
+    uint64_t *name_offset = (uint64_t *) malloc(num_process * sizeof(uint64_t));
+    ProcessInfo **first_use = (ProcessInfo **) malloc(num_process * sizeof(ProcessInfo *));
+    int num_names;
+    uint64_t table_size = lay_out_names(processes, num_process, name_offset, first_use, &num_names);
+    fwrite(WORKLOAD_MAGIC, 1, WORKLOAD_MAGIC_SIZE, fp);
+    put_varint(fp, strlen(policy));
+    fputs(policy, fp);
+    put_varint(fp, num_process);
+    put_varint(fp, table_size);
+    for (int i = 0; i < num_names; i++) {
+        fwrite(first_use[i]->name, 1, strlen(first_use[i]->name) + 1, fp);
+    }
+    int previous_arrival = 0;
+    uint64_t previous_offset = 0;
+    for (int i = 0; i < num_process; i++) {
+        ProcessInfo *p = &processes[i];
+        if (p->time_needed < 0) {
+            fprintf(stderr, "%s: a negative execution time can't be written in binary\n", p->name);
+            exit(1);
+        }
+        put_signed_varint(fp, (int64_t) p->arrival_time - previous_arrival);
+        previous_arrival = p->arrival_time;
+        put_varint(fp, p->time_needed);
+        put_signed_varint(fp, (int64_t) (name_offset[i] - previous_offset));
+        previous_offset = name_offset[i];
+        int value;
+        put_signed_varint(fp, fourth_column(p, &value) ? (int64_t) value + 1 : 0);
+    }
+    free(name_offset);
+    free(first_use);
+}
+
+static void write_text(FILE *fp, const char *policy, ProcessInfo *processes, int num_process) {
+    fprintf(fp, "%s\n%d\n", policy, num_process);
+    for (int i = 0; i < num_process; i++) {
+        ProcessInfo *p = &processes[i];
+        int value;
+        if (fourth_column(p, &value)) {
+            fprintf(fp, "%s %d %d %d\n", p->name, p->arrival_time, p->time_needed, value);
+        } else {
+            fprintf(fp, "%s %d %d\n", p->name, p->arrival_time, p->time_needed);
+        }
+    }
+}
+
+void workload_write(FILE *fp, const char *policy, ProcessInfo *processes, int num_process, WorkloadFormat format) {
+    if (format == BINARY_WORKLOAD) {
+        write_binary(fp, policy, processes, num_process);
+    } else {
+        write_text(fp, policy, processes, num_process);
+    }
+    if (fflush(fp) != 0 || ferror(fp)) {
+        perror("Can't write the workload");
+        exit(1);
+    }
+}